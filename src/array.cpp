@@ -7,6 +7,51 @@
 #ifdef ARRAY_CPP
 #include "parkinson.hpp"
 
+// See object.cpp
+json::value copyScalar(const json::value& val);
+
+// See share.cpp
+json::object* ownObject(json::value& slot, json::object* parentObject, json::array* parentArray, const std::string& key, size_t index);
+json::array* ownArray(json::value& slot, json::object* parentObject, json::array* parentArray, const std::string& key, size_t index);
+void unshare(json::object& object);
+void unshare(json::array& array);
+
+// Pointing the children to the array after it was moved (see object.cpp)
+static void adoptChildren(json::array& array) {
+    for(auto& val: array.data) {
+        if(auto child = std::get_if<std::unique_ptr<json::object>>(&val.value)) (*child)->parentArray = &array;
+        else if(auto child = std::get_if<std::unique_ptr<json::array>>(&val.value)) (*child)->parentArray = &array;
+    }
+    if(!array.share) return;
+    auto adopt = [&array](json::shareState::borrowedChild& child) {
+        if(child.objectCopy) child.objectCopy->parentArray = &array;
+        else if(child.arrayCopy) child.arrayCopy->parentArray = &array;
+    };
+    for(auto& [origin, child]: array.share->borrowed) adopt(child);
+    for(auto& child: array.share->orphans) adopt(child);
+}
+
+json::array::array(json::array&& other) noexcept
+    : data(std::move(other.data)), parentArray(other.parentArray), parentObject(other.parentObject), 
+      cacheOutput(other.cacheOutput), outputCache(std::move(other.outputCache)), 
+      outputCacheIndent(other.outputCacheIndent), outputDirty(other.outputDirty), share(std::move(other.share)) {
+    adoptChildren(*this);
+}
+
+json::array& json::array::operator=(json::array&& other) noexcept {
+    if(this == &other) return *this;
+    data = std::move(other.data);
+    parentArray = other.parentArray;
+    parentObject = other.parentObject;
+    cacheOutput = other.cacheOutput;
+    outputCache = std::move(other.outputCache);
+    outputCacheIndent = other.outputCacheIndent;
+    outputDirty = other.outputDirty;
+    share = std::move(other.share);
+    adoptChildren(*this);
+    return *this;
+}
+
 bool json::array::getType(size_t index, json::types &type) {
     if(data.size() - 1 < index) return false;
     type = data[index].type;
@@ -23,21 +68,13 @@ bool json::array::get(size_t index, std::string &out) {
 bool json::array::get(size_t index, long long &out) {
     if(data.size() - 1 < index) return false;
     if(data[index].type != JSON_NUMBER) return false;
-    if(long long *x = std::get_if<long long>(&data[index].value)) {
-        out = *x;
-        return true;
-    }
-    return false;
+    return data[index].getNumber(out);
 }
 
 bool json::array::get(size_t index, double &out) {
     if(data.size() - 1 < index) return false;
     if(data[index].type != JSON_NUMBER) return false;
-    if(double *x = std::get_if<double>(&data[index].value)) {
-        out = *x;
-        return true;
-    }
-    return false;   
+    return data[index].getNumber(out);
 }
 
 bool json::array::get(size_t index, bool &out) {
@@ -56,43 +93,64 @@ bool json::array::isNull(size_t index) {
 bool json::array::get(size_t index, json::object *&out) {
     if(data.size() - 1 < index) return false;
     if(data[index].type != JSON_OBJECT) return false;
-    out = std::get<std::unique_ptr<json::object>>(data[index].value).get();
+    out = ownObject(data[index], nullptr, this, std::string(), index);
     return true;
 }
 
 bool json::array::get(size_t index, json::array *&out) {
     if(data.size() - 1 < index) return false;
     if(data[index].type != JSON_ARRAY) return false;
-    out = std::get<std::unique_ptr<json::array>>(data[index].value).get();
+    out = ownArray(data[index], nullptr, this, std::string(), index);
+    return true;
+}
+
+bool json::array::get(size_t index, const json::object *&out) const {
+    if(data.size() - 1 < index) return false;
+    if(data[index].type != JSON_OBJECT) return false;
+    out = data[index].getObject();
+    return true;
+}
+
+bool json::array::get(size_t index, const json::array *&out) const {
+    if(data.size() - 1 < index) return false;
+    if(data[index].type != JSON_ARRAY) return false;
+    out = data[index].getArray();
     return true;
 }
 
 void json::array::push(std::string value) {
+    invalidate();
     data.push_back(json::value{ value, JSON_STRING });
 }
 
 void json::array::push(const char* value) {
+    invalidate();
     data.push_back(json::value{ std::string(value), JSON_STRING });
 }
 
 void json::array::push(long long value) {
+    invalidate();
     data.push_back(json::value{ value, JSON_NUMBER });
 }
 
 void json::array::push(double value) {
+    invalidate();
     data.push_back(json::value{ value, JSON_NUMBER });
 }
 
 void json::array::push(bool value) {
+    invalidate();
     data.push_back(json::value{ value, JSON_BOOL });
 }
 
 void json::array::push(std::unique_ptr<json::object> value) {
+    invalidate();
     value->addParentArray(this);
     data.push_back(json::value{ std::move(value), JSON_OBJECT });
 }
 
 void json::array::push(std::unique_ptr<json::array> value) {
+    invalidate();
     value->addParentArray(this);
     data.push_back(json::value{ std::move(value), JSON_ARRAY });
 }
@@ -114,59 +172,71 @@ json::array& json::array::pushArray() {
 }
 
 void json::array::pushNull() {
+    invalidate();
     data.push_back(json::value{ std::monostate{}, JSON_NULL });
 }
 
 bool json::array::setValue(uint index, std::string value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
     data[index] = json::value{ value, JSON_STRING };
     return true;
 }
 
 bool json::array::setValue(uint index, const char* value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
     data[index] = json::value{ std::string(value), JSON_STRING };
     return true;
 }
 
 bool json::array::setValue(uint index, long long value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
     data[index] = json::value{ value, JSON_NUMBER };
     return true;
 }
 
 bool json::array::setValue(uint index, double value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
     data[index] = json::value{ value, JSON_NUMBER };
     return true;
 }
 
 bool json::array::setValue(uint index, bool value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
     data[index] = json::value{ value, JSON_BOOL };
     return true;
 }
 
 bool json::array::setValue(uint index, std::unique_ptr<json::object> value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
+    value->addParentArray(this);
     data[index] = json::value{ std::move(value), JSON_OBJECT };
     return true;
 }
 
 bool json::array::setValue(uint index, std::unique_ptr<json::array> value) {
     if(data.size() - 1 < index) return false;
+    invalidate();
+    value->addParentArray(this);
     data[index] = json::value{ std::move(value), JSON_ARRAY };
     return true;
 }
 
 bool json::array::setNull(uint index) {
     if(data.size() - 1 < index) return false;
+    invalidate();
     data[index] = json::value{ std::monostate{}, JSON_NULL };
     return true;
 }
 
 json::object* json::array::emplaceObject(uint index) {
     if(data.size() - 1 < index) return nullptr;
+    invalidate();
     auto obj = std::make_unique<json::object>();
     obj->addParentArray(this);
     data[index] = json::value{ std::move(obj), JSON_OBJECT };
@@ -175,61 +245,68 @@ json::object* json::array::emplaceObject(uint index) {
 
 json::array* json::array::emplaceArray(uint index) {
     if(data.size() - 1 < index) return nullptr;
+    invalidate();
     auto arr = std::make_unique<json::array>();
-    data[index] = json::value{ std::move(arr), JSON_OBJECT };
+    arr->addParentArray(this);
+    data[index] = json::value{ std::move(arr), JSON_ARRAY };
     return std::get<std::unique_ptr<json::array>>(data[index].value).get();
 }
 
 bool json::array::remove(uint index) {
    if(data.size() - 1 < index) return false;
+   invalidate();
    data.erase(data.begin() + index);
    return true;
 }
 
-std::unique_ptr<json::array> json::array::copy(json::array &original) {
+std::unique_ptr<json::array> json::array::copy(const json::array &original) {
     std::unique_ptr<json::array> array = std::make_unique<json::array>();
+    array->cacheOutput = original.cacheOutput;
+    array->data.reserve(original.data.size());
     for(auto& el: original.data) {
-        json::value val;
-        val.type = el.type;
         switch(el.type) {
-            case JSON_STRING: {
-                val.value = std::get<std::string>(el.value);
-                break;  
-            }
-            case JSON_NUMBER: {
-                long long *t;
-                if((t = std::get_if<long long>(&el.value))) val.value = *t;
-                else val.value = std::get<double>(el.value);
-                break;  
-            }
-            case JSON_BOOL: {
-                val.value = std::get<bool>(el.value);
-                break;  
-            }
-            case JSON_NULL: { 
-                val.value = std::monostate{};
-                break;  
-            }
             case JSON_OBJECT: {
-                auto &origObj = *std::get<std::unique_ptr<json::object>>(el.value);
-                auto copyObj = json::object::copy(origObj);
+                if(auto shared = std::get_if<std::shared_ptr<const json::object>>(&el.value)) {
+                    array->data.push_back(json::value{ *shared, JSON_OBJECT });
+                    break;
+                }
+                auto copyObj = json::object::copy(*std::get<std::unique_ptr<json::object>>(el.value));
                 copyObj->addParentArray(array.get());
-                val.value = std::move(copyObj);
+                array->data.push_back(json::value{ std::move(copyObj), JSON_OBJECT });
                 break;
             }
             case JSON_ARRAY: {
-                auto &origArr = *std::get<std::unique_ptr<json::array>>(el.value);
-                auto copyArr = json::array::copy(origArr);
+                if(auto shared = std::get_if<std::shared_ptr<const json::array>>(&el.value)) {
+                    array->data.push_back(json::value{ *shared, JSON_ARRAY });
+                    break;
+                }
+                auto copyArr = json::array::copy(*std::get<std::unique_ptr<json::array>>(el.value));
                 copyArr->addParentArray(array.get());
-                val.value = std::move(copyArr);
+                array->data.push_back(json::value{ std::move(copyArr), JSON_ARRAY });
                 break;
             }
+            default:
+                array->data.push_back(copyScalar(el));
         }
-        array->data.push_back(std::move(val));
     }
     return array;
 }
 
+size_t json::array::countNodes(size_t limit) const {
+    size_t count = 1;
+    for(auto& el: data) {
+        if(count >= limit) break;
+        if(el.type == JSON_OBJECT) {
+            count += el.getObject()->countNodes(limit - count);
+        } else if(el.type == JSON_ARRAY) {
+            count += el.getArray()->countNodes(limit - count);
+        } else {
+            count++;
+        }
+    }
+    return count;
+}
+
 json::object* json::array::goToParentObject() {
     return parentObject;
 }
@@ -238,6 +315,42 @@ json::array* json::array::goToParentArray() {
     return parentArray; 
 }
 
+void json::array::setOutputCache(bool enable, bool recursive) {
+    cacheOutput = enable;
+    outputCacheIndent = -1;
+    if(!enable) std::string().swap(outputCache);
+    if(!recursive) return;
+    for(auto& el: data) {
+        if(auto obj = std::get_if<std::unique_ptr<json::object>>(&el.value)) {
+            (*obj)->setOutputCache(enable, recursive);
+        } else if(auto arr = std::get_if<std::unique_ptr<json::array>>(&el.value)) {
+            (*arr)->setOutputCache(enable, recursive);
+        }
+    }
+}
+
+void json::array::invalidate() {
+    json::object* obj = nullptr;
+    json::array* arr = this;
+    while(obj != nullptr || arr != nullptr) {
+        if(obj != nullptr) {
+            if(obj->outputDirty && !(obj->share && obj->share->active())) return;
+            obj->outputDirty = true;
+            obj->outputCacheIndent = -1;
+            if(obj->share) unshare(*obj);
+            arr = obj->parentArray;
+            obj = obj->parent;
+        } else {
+            if(arr->outputDirty && !(arr->share && arr->share->active())) return;
+            arr->outputDirty = true;
+            arr->outputCacheIndent = -1;
+            if(arr->share) unshare(*arr);
+            obj = arr->parentObject;
+            arr = arr->parentArray;
+        }
+    }
+}
+
 int json::array::length() {
     return data.size();
 } 
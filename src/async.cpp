@@ -0,0 +1,128 @@
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// --- epoll reactor ---
+
+json::epollExecutor::epollExecutor() {
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+}
+
+json::epollExecutor::~epollExecutor() {
+    if(epoll >= 0) close(epoll);
+}
+
+bool json::epollExecutor::waitReadable(int fd, std::coroutine_handle<> coroutine) {
+    epoll_event event{};
+    // One shot: fd is disabled after the event until the next wait 
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.ptr = coroutine.address();
+    bool added = epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event) == 0 
+              || (errno == ENOENT && epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0);
+    if(added) waits.insert(coroutine.address());
+    return added;
+}
+
+void json::epollExecutor::cancel(int fd, std::coroutine_handle<> coroutine) {
+    if(waits.erase(coroutine.address()) == 0) return;
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int json::epollExecutor::poll(int timeout) {
+    if(waits.empty()) return 0;
+    epoll_event events[64];
+    int count = epoll_wait(epoll, events, 64, timeout);
+    int resumed = 0;
+    for(int i = 0; i < count; i++) {
+        // Coroutine resumed before may have destroyed this one
+        if(waits.erase(events[i].data.ptr) == 0) continue;
+        std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+        resumed++;
+    }
+    return resumed;
+}
+
+void json::epollExecutor::run() {
+    while(!waits.empty()) poll(-1);
+}
+
+// --- Async parsing ---
+
+// Awaiting fd to become readable
+struct readable {
+    json::executor& executor;
+    int fd;
+    // Coroutine registered on the executor until it is resumed
+    std::coroutine_handle<> waiting = nullptr;
+    bool registered = false;
+    bool await_ready() { return false; }
+    // Coroutine continues right away if the executor can't wait for fd
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+        registered = executor.waitReadable(fd, coroutine);
+        if(registered) waiting = coroutine;
+        return registered;
+    }
+    // False if fd couldn't be waited for
+    bool await_resume() {
+        waiting = nullptr;
+        return registered;
+    }
+    // Awaiter is destroyed with the frame of the coroutine destroyed while it waits
+    ~readable() { if(waiting) executor.cancel(fd, waiting); }
+};
+
+// pending is nullptr if the bytes after the root are dropped
+static json::task<json::object> parseFd(int fd, json::executor& executor, json::exitCode& code, std::string* pending) {
+    json::object object;
+    domBuilder builder(object);
+    parserScratch scratch;
+    textParser<domBuilder> parser(builder, code, scratch);
+    // Coroutine frame is kept while waiting, so the buffer is small 
+    char buffer[4096];
+    // Read text isn't kept to find the error later, so lines are counted while reading
+    lineCounter counter;
+    int result = -1;
+    // Parsing the bytes until the root ends, returns the number of bytes parsed
+    auto take = [&](const char* data, size_t size) {
+        size_t i = 0;
+        while(i < size && result < 0) {
+            counter.add(data[i]);
+            result = parser.step(data[i++]);
+        }
+        return i;
+    };
+    if(pending != nullptr) pending->erase(0, take(pending->data(), pending->size()));
+    while(result < 0) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if(got > 0) {
+            size_t used = take(buffer, got);
+            if(pending != nullptr) pending->append(buffer + used, got - used);
+        } else if(got == 0) {
+            result = parser.finish();
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Without the wait the read would be tried again forever
+            if(!co_await readable{executor, fd}) {
+                constructExitCode(code, json::PARSE_ERR_IO, parser.offset);
+                result = 0;
+            }
+        } else if(errno != EINTR) {
+            constructExitCode(code, json::PARSE_ERR_IO, parser.offset);
+            result = 0;
+        }
+    }
+    if(result == 0) {
+        code.lineNumber = counter.line;
+        code.characterNumber = counter.character;
+    }
+    co_return std::move(object);
+}
+
+json::task<json::object> json::parseAsync(int fd, json::executor& executor, json::exitCode& code) {
+    return parseFd(fd, executor, code, nullptr);
+}
+
+json::task<json::object> json::parseAsync(int fd, json::executor& executor, json::exitCode& code, std::string& pending) {
+    return parseFd(fd, executor, code, &pending);
+}
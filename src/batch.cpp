@@ -0,0 +1,27 @@
+#include <algorithm>
+#include <numeric>
+#include "parkinson.hpp"
+
+size_t json::parseBatch(std::span<const std::string_view> inputs, std::vector<json::object>& outs, std::vector<json::exitCode>& codes, json::threadPool& pool) {
+    outs.resize(inputs.size());
+    codes.resize(inputs.size());
+    // Biggest documents go first, the small ones fill the gaps at the end
+    std::vector<size_t> order(inputs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return inputs[a].size() > inputs[b].size();
+    });
+    std::atomic<size_t> parsed = 0;
+    pool.run(order.size(), [&](size_t task) {
+        size_t i = order[task];
+        outs[i].clear();
+        if(json::parse(inputs[i], outs[i], codes[i])) parsed.fetch_add(1, std::memory_order_relaxed);
+    });
+    return parsed.load();
+}
+
+size_t json::parseBatch(std::span<const std::string_view> inputs, std::vector<json::object>& outs, std::vector<json::exitCode>& codes, unsigned threads) {
+    if(threads == 0) return parseBatch(inputs, outs, codes, json::threadPool::shared());
+    json::threadPool pool(threads);
+    return parseBatch(inputs, outs, codes, pool);
+}
@@ -0,0 +1,470 @@
+// Benchmark of the parser loop. Every input is parsed by the baseline loop (see below), character by character
+// through step(), the way streams are parsed, and token by token through feed(), the way text in memory is parsed.
+// Speedups are of step() and feed() over the baseline.
+// Inputs are the files of the test directory and generated documents
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// --- Baseline ---
+// Parser loop before the character tables and feed(): the switch over parserState with the branching
+// isWhiteSpace/detectValueType. Compiled with the same flags as the current loop, so only the loops differ.
+// Helpers are kept out of line, the way they were in parkinson.cpp
+namespace baseline {
+
+[[gnu::noinline]] int isWhiteSpace(char ch) {
+    if(ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+        return 1;
+    else 
+        return 0;
+}
+
+[[gnu::noinline]] int detectValueType(char ch, json::types& type) {
+    switch (ch) {
+        case '"':
+            type = json::JSON_STRING;
+            break;
+        case '[':
+            type = json::JSON_ARRAY;
+            break;
+        case '{':
+            type = json::JSON_OBJECT;
+            break;
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':               
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+        case '-':
+        case '.':
+           type = json::JSON_NUMBER;
+           break;
+        case 't':
+        case 'f':  
+            type = json::JSON_BOOL;
+            break;
+        case 'n':
+            type = json::JSON_NULL;
+            break;
+        default:
+            return -1;
+    }
+    return json::PARSE_SUCCESS;
+}
+
+[[gnu::noinline]] int checkStringEnd(char ch) {
+     if(ch == '"') {
+        return 1;
+     } else {
+        return 0;
+     }
+}
+
+template<typename Builder> struct textParser {
+    Builder& builder;
+    json::exitCode& code;
+    // Bytes read, errors keep it in exitCode::offset 
+    size_t offset = 0;
+    parserState state = WAITING_FOR_OBJECT;
+    json::types type = json::JSON_NULL;
+    // Structures that are being parsed, 'o' for objects and 'a' for arrays
+    std::string& context;
+    //Key temp string
+    std::string& tmpKey;
+    std::string& key;
+    // Temp values of the pair
+    std::string& tmpVal;
+    std::string& processed;
+    bool prevBS = false;
+
+    textParser(Builder& builder, json::exitCode& code, parserScratch& scratch) 
+        : builder(builder), code(code), context(scratch.context), tmpKey(scratch.tmpKey), key(scratch.key), tmpVal(scratch.tmpVal), processed(scratch.processed) {
+        scratch.clear();
+    }
+
+    // Parsing the next character. Returns -1 if more text is needed, 
+    // 1 and PARSE_SUCCESS when the root object is closed, 0 and the error in the code on error 
+    int step(char ch) {
+        using namespace json;
+        offset++;
+
+        if((state != WRITE_VALUE) && isWhiteSpace(ch)) {
+           return -1;
+        }
+
+        switch (state) {
+            // BEGINNING OF THE OBJECT PARSING
+            case WAITING_FOR_OBJECT: {
+                if(ch == '{') {
+                    state = BEGIN_KEY;
+                    context.push_back('o');
+                    builder.beginRoot();
+                }
+                else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_OBJECT_START, offset);
+                    return 0;
+                }
+                break;
+            }
+            // BEGINNING OF KEY WRITING
+            case BEGIN_KEY: {
+                if(ch == '"') {
+                    state = WRITE_KEY;
+                    prevBS = false;
+                } else if(ch == '}') {
+                    state = VALUE_WRITTEN;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_KEY_DECLARATION, offset);
+                    return 0;
+                }
+                break;
+            }
+            // WRITING THE KEY
+            case WRITE_KEY: {
+                if(ch == '"' && !prevBS) {
+                    state = KEY_WRITTEN;
+                    if(!processString(tmpKey, key)) {
+                        constructExitCode(code, PARSE_ERR_INCORRECT_UNICODE_ESC_IN_KEY, offset);
+                        return 0;
+                    }
+                    if(!builder.key(key)){
+                        constructExitCode(code, PARSE_ERR_DUPLICATE_ELEMENTS, offset);
+                        return 0;
+                    }
+                    key.clear();
+                    tmpKey.clear();
+                } else {
+                    tmpKey += ch;
+                    prevBS = (ch == '\\' && !prevBS);
+                }
+                break;
+            }
+            // CHECKING SEPARATOR BETWEEN KEY AND VALUE
+            case KEY_WRITTEN: {
+                if(ch == ':') {
+                    state = BEGIN_VALUE;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_KEY_VALUE_SEPARATOR, offset);
+                    return 0;
+                }
+                break;
+            }
+            // CHECKING VALUE TYPE
+            case BEGIN_VALUE: {
+                prevBS = false;
+                int retCode = detectValueType(ch, type);
+                if(ch == '}') {
+                    constructExitCode(code, PARSER_ERR_COMMA_AFTER_LAST_ELEMENT, offset);
+                    return 0;
+                } else if(ch == ']') {
+                    if(type == JSON_ARRAY) {
+                        state = VALUE_WRITTEN;
+                        break;
+                    } else {
+                        constructExitCode(code, PARSER_ERR_COMMA_AFTER_LAST_ELEMENT, offset);
+                        return 0;
+                    }
+                }
+                if(retCode == -1) {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_VALUE_TYPE, offset);
+                    return 0;
+                }
+                if(type == JSON_NUMBER || type == JSON_BOOL || type == JSON_NULL) {
+                    tmpVal += ch;
+                } else if(type == JSON_ARRAY) {
+                    builder.beginArray();
+                    context.push_back('a');
+                    state = BEGIN_VALUE;
+                    tmpVal.clear();
+                    break;
+                } else if(type == JSON_OBJECT) {
+                    builder.beginObject();
+                    context.push_back('o');
+                    state = BEGIN_KEY;
+                    tmpVal.clear();
+                    break;
+                }
+                state = WRITE_VALUE;
+                break;
+            }
+            // WRITING VALUE DEPENDING ON THE VALUE TYPE
+            case WRITE_VALUE: {
+                switch (type) {
+                    // --- Writing string values ---
+                    case JSON_STRING: {
+                        if(checkStringEnd(ch) && !prevBS) {
+                            processed.clear();
+                            if(!processString(tmpVal, processed)) {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_UNICODE_DECLARATION, offset);
+                                return 0;
+                            }
+                            builder.value(std::move(processed));
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                            return -1;
+                        } else {
+                            tmpVal += ch;
+                            prevBS = (ch == '\\' && !prevBS);
+                        }
+                        break;
+                    }
+                    // --- Writing number (int/float) values ---
+                    case JSON_NUMBER: {
+                        if(isWhiteSpace(ch) || ch == ',' || ch == ']' || ch == '}') {
+                            bool success = processNumber(tmpVal);
+                            if(!success) {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_NUMBER_DEFINITION, offset);
+                                return 0;
+                            }
+                            bool isInt = isWhole(tmpVal);
+                            // Builders with lazyNumbers set keep the text and convert it when it is read (see domBuilder)
+                            bool lazy = false;
+                            if constexpr(requires { builder.lazyNumbers; }) lazy = builder.lazyNumbers;
+                            if(isInt) {
+                                if(!lazy) {
+                                    errno = 0;
+                                    long long i = std::strtoll(tmpVal.c_str(), nullptr, 10);
+                                    builder.value(i);
+                                }
+                            // Only numbers with an exponent or hundreds of digits can be out of the range of double,
+                            // lazy numbers skip the conversion otherwise 
+                            } else if(!lazy || tmpVal.size() > 300 || tmpVal.find_first_of("eE") != std::string::npos) {
+                                double d = std::strtod(tmpVal.c_str(), nullptr);
+                                if(errno == ERANGE && !std::isfinite(d)) {
+                                    constructExitCode(code, PARSE_ERR_NUMBER_OVERFLOW_OR_UNDERFLOW, offset);
+                                    return 0;
+                                }
+                                if(!lazy) builder.value(d);
+                            }
+                            if constexpr(requires { builder.lazyNumbers; }) {
+                                if(lazy) builder.number(tmpVal, isInt);
+                            }
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                        } else {
+                            tmpVal += ch;
+                        }
+                        break;
+                    }
+                    // --- Writing boolean variable ---
+                    case JSON_BOOL: {
+                        if(isWhiteSpace(ch) || ch == ',' || ch == ']' || ch == '}') {
+                            // If value in the buffer is "true" make true
+                            if(tmpVal == std::string("true")) {
+                                builder.value(true);
+                            }
+                            // If value in buffer is "false" make false
+                            else if(tmpVal == std::string("false")) {
+                                builder.value(false);
+                            }
+                            // If neither - throw an error
+                            else {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_BOOL_DEFINITION, offset);
+                                return 0;
+                            }
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                        } else {
+                            tmpVal += ch;
+                        }
+                        break;
+                    }
+                    case JSON_NULL: {
+                        if(isWhiteSpace(ch) || ch == ',' || ch == ']' || ch == '}') {
+                            if(tmpVal == std::string("null")) {
+                                builder.null();
+                            } else {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_NULL_VALUE_DEFINITION, offset);
+                                return 0;
+                            }
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                        } else {
+                            tmpVal += ch;
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                break;
+            }
+            // What to do when the value is written
+            case VALUE_WRITTEN:
+                break;
+        }
+        // If value is written, outside of the switch case it will be checked
+        if (state == VALUE_WRITTEN) {
+            if(isWhiteSpace(ch)) return -1;
+            if(context.back() == 'a') {
+                if(ch == ',') {
+                    state = BEGIN_VALUE;
+                }
+                else if(ch == ']') {
+                    builder.endArray();
+                    context.pop_back();
+                    state = VALUE_WRITTEN;
+                } else if(ch == '}') {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_ARRAY_ENDING, offset);
+                    return 0;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_VALUE_ENDING, offset);
+                    return 0;
+                }
+            } else {
+                if(ch == ',') state = BEGIN_KEY;
+                else if(ch == '}') {
+                    builder.endObject();
+                    context.pop_back();
+                    if(context.empty()) {
+                        constructExitCode(code, PARSE_SUCCESS, 0, 0);
+                        return 1;
+                    }
+                } else if(ch == ']') {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_OBJECT_ENDING, offset);
+                    return 0;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_VALUE_ENDING, offset);
+                    return 0;
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Text ended before the root object was closed
+    int finish() {
+        constructExitCode(code, json::PARSE_ERR_INCORRECT_OBJECT_ENDING, offset);
+        return 0;
+    }
+};
+
+}
+
+// Same as bufferSource, but parseText reads it character by character
+struct charSource {
+    const char* at;
+    const char* end;
+    const char* begin = at;
+    bool get(char& ch) {
+        if(at == end) return false;
+        ch = *at++;
+        return true;
+    }
+    void locate(json::exitCode& code) { locateText(code, begin, code.offset); }
+};
+
+// Seconds per parse of the text, best of the runs. parse takes the builder, the code and the scratch
+template<typename Parse> static double timeParse(int runs, Parse parse) {
+    parserScratch scratch;
+    double best = 1e9;
+    for(int i = 0; i < runs; i++) {
+        json::object object;
+        json::exitCode code;
+        domBuilder builder(object);
+        auto start = std::chrono::steady_clock::now();
+        if(parse(builder, code, scratch) != 1) {
+            std::cerr << "Parse failed: " << code.message << "\n";
+            return 0;
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+template<typename Source> static double timeSource(const std::string& text, int runs) {
+    return timeParse(runs, [&](domBuilder& builder, json::exitCode& code, parserScratch& scratch) {
+        Source source{text.data(), text.data() + text.size()};
+        return parseText(source, builder, code, scratch);
+    });
+}
+
+// Stream is made once and read again from the start by every run
+static double timeStream(const std::string& text, int runs) {
+    std::istringstream in(text);
+    return timeParse(runs, [&](domBuilder& builder, json::exitCode& code, parserScratch& scratch) {
+        in.clear();
+        in.seekg(0);
+        return parseText(in, builder, code, scratch);
+    });
+}
+
+static double timeBaseline(const std::string& text, int runs) {
+    return timeParse(runs, [&](domBuilder& builder, json::exitCode& code, parserScratch& scratch) {
+        baseline::textParser<domBuilder> parser(builder, code, scratch);
+        int result = -1;
+        for(size_t i = 0; i < text.size() && result < 0; i++) result = parser.step(text[i]);
+        return result < 0 ? parser.finish() : result;
+    });
+}
+
+static void report(const std::string& name, const std::string& text, int runs) {
+    double old = timeBaseline(text, runs);
+    double step = timeSource<charSource>(text, runs);
+    double feed = timeSource<bufferSource>(text, runs);
+    double stream = timeStream(text, runs);
+    double megabytes = text.size() / 1e6;
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << megabytes << " MB"
+              << std::setw(10) << megabytes / old << " MB/s baseline"
+              << std::setw(10) << megabytes / step << " MB/s step"
+              << std::setw(10) << megabytes / feed << " MB/s feed"
+              << std::setw(10) << megabytes / stream << " MB/s stream"
+              << std::setw(8) << old / step << "x step"
+              << std::setw(8) << old / feed << "x feed"
+              << std::setw(8) << old / stream << "x stream\n";
+}
+
+static std::string records(int count) {
+    std::string text = "{\"records\": [";
+    for(int i = 0; i < count; i++) {
+        if(i > 0) text += ",\n    ";
+        text += "{\"id\": " + std::to_string(i) + ", \"name\": \"user number " + std::to_string(i) + "\", \"score\": "
+              + std::to_string(i % 1000) + ".25, \"tags\": [\"alpha\", \"beta\"], \"active\": true, \"note\": null}";
+    }
+    return text + "]}";
+}
+
+static std::string strings(int count) {
+    std::string text = "{\"text\": [";
+    for(int i = 0; i < count; i++) {
+        if(i > 0) text += ", ";
+        text += "\"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt \\\"" + std::to_string(i) + "\\\"\"";
+    }
+    return text + "]}";
+}
+
+static std::string numbers(int count) {
+    std::string text = "{\"numbers\": [";
+    for(int i = 0; i < count; i++) {
+        if(i > 0) text += ", ";
+        text += std::to_string(i * 7919LL) + (i % 2 ? ".5" : "");
+    }
+    return text + "]}";
+}
+
+int main(void) {
+    if(std::filesystem::is_directory("./test")) {
+        for(auto& entry: std::filesystem::directory_iterator("./test")) {
+            if(entry.path().extension() != ".json") continue;
+            std::ifstream file(entry.path());
+            std::stringstream text;
+            text << file.rdbuf();
+            report(entry.path().filename().string(), text.str(), 2000);
+        }
+    }
+    report("generated records", records(100000), 5);
+    report("generated strings", strings(100000), 5);
+    report("generated numbers", numbers(500000), 5);
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "parkinson.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ostream>
+
+// --- Canonical output (RFC 8785) ---
+// Writer is a template over the sink, so the same code writes the text 
+// into a stream or feeds it to the hash without building the text 
+
+// Decoding code point that starts at s[i]. Strings in the objects are valid UTF-8
+uint32_t decodeCodepoint(const std::string& s, size_t i) {
+    unsigned char c = s[i];
+    if(c < 0x80) return c;
+    int len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+    uint32_t cp = c & (0x3F >> (len - 1));
+    for(int k = 1; k < len && i + k < s.size(); k++) cp = (cp << 6) | (s[i + k] & 0x3F);
+    return cp;
+}
+
+// Comparing keys by their UTF-16 code units as RFC 8785 requires.
+// UTF-8 byte order is the code point order, it differs from UTF-16 order only 
+// when code point above U+FFFF (surrogate pair) is compared with U+E000..U+FFFF 
+bool canonicalKeyLess(const std::string& a, const std::string& b) {
+    auto diff = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+    size_t i = diff.first - a.begin();
+    if(i == b.size()) return false;
+    if(i == a.size()) return true;
+    // Going back to the first byte of the code point
+    while(i > 0 && (static_cast<unsigned char>(a[i]) & 0xC0) == 0x80) i--;
+    uint32_t cpa = decodeCodepoint(a, i);
+    uint32_t cpb = decodeCodepoint(b, i);
+    uint32_t ua = cpa < 0x10000 ? cpa : 0xD800 + ((cpa - 0x10000) >> 10);
+    uint32_t ub = cpb < 0x10000 ? cpb : 0xD800 + ((cpb - 0x10000) >> 10);
+    if(ua != ub) return ua < ub;
+    return cpa < cpb;
+}
+
+// Writing double the way ECMAScript Number.prototype.toString does 
+template<typename Sink> bool writeCanonicalDouble(Sink& sink, double d) {
+    if(!std::isfinite(d)) return false;
+    if(d == 0) {
+        sink.write("0", 1);
+        return true;
+    }
+    char buf[32];
+    // Shortest representation that reads back to the same double: d[.ddd]e[+-]xx
+    auto res = std::to_chars(buf, buf + sizeof(buf), d, std::chars_format::scientific);
+    const char* p = buf;
+    if(*p == '-') {
+        sink.write("-", 1);
+        p++;
+    }
+    char digits[20];
+    int k = 0;
+    for(; p < res.ptr && *p != 'e'; p++) {
+        if(*p != '.') digits[k++] = *p;
+    }
+    // Exponent after 'e' is always signed 
+    int exp = 0;
+    bool negExp = p[1] == '-';
+    for(p += 2; p < res.ptr; p++) exp = exp * 10 + (*p - '0');
+    if(negExp) exp = -exp;
+    int n = exp + 1;
+    if(k <= n && n <= 21) {
+        sink.write(digits, k);
+        for(int i = k; i < n; i++) sink.write("0", 1);
+    } else if(0 < n && n <= 21) {
+        sink.write(digits, n);
+        sink.write(".", 1);
+        sink.write(digits + n, k - n);
+    } else if(-6 < n && n <= 0) {
+        sink.write("0.", 2);
+        for(int i = n; i < 0; i++) sink.write("0", 1);
+        sink.write(digits, k);
+    } else {
+        sink.write(digits, 1);
+        if(k > 1) {
+            sink.write(".", 1);
+            sink.write(digits + 1, k - 1);
+        }
+        char e[8];
+        int len = std::snprintf(e, sizeof(e), "e%c%d", n - 1 < 0 ? '-' : '+', std::abs(n - 1));
+        sink.write(e, len);
+    }
+    return true;
+}
+
+template<typename Sink> void writeCanonicalString(Sink& sink, const std::string& s) {
+    static const char hex[] = "0123456789abcdef";
+    sink.write("\"", 1);
+    size_t run = 0;
+    for(size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if(c >= 0x20 && c != '"' && c != '\\') continue;
+        // Writing unescaped characters before the escaped one in one piece 
+        sink.write(s.data() + run, i - run);
+        run = i + 1;
+        switch(c) {
+            case '"':  sink.write("\\\"", 2); break;
+            case '\\': sink.write("\\\\", 2); break;
+            case '\b': sink.write("\\b", 2); break;
+            case '\f': sink.write("\\f", 2); break;
+            case '\n': sink.write("\\n", 2); break;
+            case '\r': sink.write("\\r", 2); break;
+            case '\t': sink.write("\\t", 2); break;
+            default: {
+                char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                sink.write(esc, 6);
+            }
+        }
+    }
+    sink.write(s.data() + run, s.size() - run);
+    sink.write("\"", 1);
+}
+
+template<typename Sink> bool writeCanonicalValue(Sink& sink, const json::value& value);
+
+template<typename Sink> bool writeCanonicalObject(Sink& sink, const json::object& object) {
+    using member = std::pair<const std::string, json::value>;
+    std::vector<const member*> members;
+    members.reserve(object.data.size());
+    for(auto& m: object.data) members.push_back(&m);
+    std::sort(members.begin(), members.end(), [](const member* a, const member* b) {
+        return canonicalKeyLess(a->first, b->first);
+    });
+    sink.write("{", 1);
+    for(size_t i = 0; i < members.size(); i++) {
+        if(i != 0) sink.write(",", 1);
+        writeCanonicalString(sink, members[i]->first);
+        sink.write(":", 1);
+        if(!writeCanonicalValue(sink, members[i]->second)) return false;
+    }
+    sink.write("}", 1);
+    return true;
+}
+
+template<typename Sink> bool writeCanonicalArray(Sink& sink, const json::array& array) {
+    sink.write("[", 1);
+    for(size_t i = 0; i < array.data.size(); i++) {
+        if(i != 0) sink.write(",", 1);
+        if(!writeCanonicalValue(sink, array.data[i])) return false;
+    }
+    sink.write("]", 1);
+    return true;
+}
+
+template<typename Sink> bool writeCanonicalValue(Sink& sink, const json::value& value) {
+    switch(value.type) {
+        case json::JSON_STRING:
+            writeCanonicalString(sink, std::get<std::string>(value.value));
+            return true;
+        case json::JSON_NUMBER: {
+            long long integer;
+            if(value.getNumber(integer)) {
+                char buf[24];
+                auto res = std::to_chars(buf, buf + sizeof(buf), integer);
+                sink.write(buf, res.ptr - buf);
+                return true;
+            }
+            double real = 0;
+            value.getNumber(real);
+            return writeCanonicalDouble(sink, real);
+        }
+        case json::JSON_BOOL:
+            std::get<bool>(value.value) ? sink.write("true", 4) : sink.write("false", 5);
+            return true;
+        case json::JSON_NULL:
+            sink.write("null", 4);
+            return true;
+        case json::JSON_OBJECT:
+            return writeCanonicalObject(sink, *value.getObject());
+        case json::JSON_ARRAY:
+            return writeCanonicalArray(sink, *value.getArray());
+    }
+    return false;
+}
+
+struct streamSink {
+    std::ostream& stream;
+    void write(const char* data, size_t size) {
+        stream.write(data, size);
+    }
+};
+
+bool json::outputCanonical(std::ostream &stream, const json::object& object) {
+    streamSink sink{ stream };
+    return writeCanonicalObject(sink, object);
+}
+
+// --- Structural hash ---
+// Streaming XXH64 over the canonical text. 128-bit hash runs two lanes with different seeds 
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t xxhRound(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t xxhMerge(uint64_t acc, uint64_t v) {
+    acc ^= xxhRound(0, v);
+    return acc * PRIME1 + PRIME4;
+}
+
+template<int Lanes> struct hashSink {
+    uint64_t v[Lanes][4];
+    uint64_t seeds[Lanes];
+    unsigned char buf[32];
+    size_t bufLen = 0;
+    uint64_t total = 0;
+
+    explicit hashSink(const uint64_t (&s)[Lanes]) {
+        for(int l = 0; l < Lanes; l++) {
+            seeds[l] = s[l];
+            v[l][0] = s[l] + PRIME1 + PRIME2;
+            v[l][1] = s[l] + PRIME2;
+            v[l][2] = s[l];
+            v[l][3] = s[l] - PRIME1;
+        }
+    }
+    void stripe(const unsigned char* p) {
+        for(int l = 0; l < Lanes; l++) {
+            for(int i = 0; i < 4; i++) v[l][i] = xxhRound(v[l][i], read64(p + i * 8));
+        }
+    }
+    void write(const char* data, size_t size) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        total += size;
+        if(bufLen + size < 32) {
+            std::memcpy(buf + bufLen, p, size);
+            bufLen += size;
+            return;
+        }
+        if(bufLen > 0) {
+            size_t fill = 32 - bufLen;
+            std::memcpy(buf + bufLen, p, fill);
+            stripe(buf);
+            p += fill;
+            size -= fill;
+            bufLen = 0;
+        }
+        for(; size >= 32; p += 32, size -= 32) stripe(p);
+        std::memcpy(buf, p, size);
+        bufLen = size;
+    }
+    uint64_t digest(int l) const {
+        uint64_t h;
+        if(total >= 32) {
+            h = rotl(v[l][0], 1) + rotl(v[l][1], 7) + rotl(v[l][2], 12) + rotl(v[l][3], 18);
+            for(int i = 0; i < 4; i++) h = xxhMerge(h, v[l][i]);
+        } else {
+            h = seeds[l] + PRIME5;
+        }
+        h += total;
+        const unsigned char* p = buf;
+        size_t left = bufLen;
+        for(; left >= 8; p += 8, left -= 8) {
+            h ^= xxhRound(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+        }
+        if(left >= 4) {
+            uint32_t k;
+            std::memcpy(&k, p, 4);
+            h ^= static_cast<uint64_t>(k) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+            left -= 4;
+        }
+        for(; left > 0; p++, left--) {
+            h ^= *p * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+        }
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+bool json::hashCanonical(const json::object& object, uint64_t& out) {
+    hashSink<1> sink({ 0 });
+    if(!writeCanonicalObject(sink, object)) return false;
+    out = sink.digest(0);
+    return true;
+}
+
+bool json::hashCanonical(const json::object& object, json::hash128& out) {
+    hashSink<2> sink({ 0, PRIME5 });
+    if(!writeCanonicalObject(sink, object)) return false;
+    out.low = sink.digest(0);
+    out.high = sink.digest(1);
+    return true;
+}
@@ -0,0 +1,333 @@
+#include <cmath>
+#include <cstring>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// CBOR (RFC 8949). Objects are maps with text keys, arrays are arrays, numbers are integers or floats,
+// null is the simple value 22. Floats are written in the shortest form that keeps the value exactly
+
+// --- Encoding ---
+
+static void writeHead(std::vector<uint8_t>& out, uint8_t major, uint64_t argument) {
+    major <<= 5;
+    if(argument < 24) {
+        out.push_back(major | argument);
+        return;
+    }
+    int bytes;
+    if(argument <= 0xff) {
+        out.push_back(major | 24);
+        bytes = 1;
+    } else if(argument <= 0xffff) {
+        out.push_back(major | 25);
+        bytes = 2;
+    } else if(argument <= 0xffffffff) {
+        out.push_back(major | 26);
+        bytes = 4;
+    } else {
+        out.push_back(major | 27);
+        bytes = 8;
+    }
+    for(int i = bytes - 1; i >= 0; i--) out.push_back(uint8_t(argument >> (i * 8)));
+}
+
+static void writeText(std::vector<uint8_t>& out, const std::string& text) {
+    writeHead(out, 3, text.size());
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+// Half precision bits of the double if it is exactly representable, otherwise -1
+static int toHalf(double value) {
+    uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+    if(std::isnan(value)) return 0x7e00;
+    if(std::isinf(value)) return sign | 0x7c00;
+    if(value == 0) return sign;
+    int exponent;
+    double mantissa = std::frexp(std::fabs(value), &exponent);
+    // value = mantissa * 2^exponent, mantissa in [0.5, 1)
+    if(exponent > 16) return -1;
+    if(exponent >= -13) {
+        double bits = std::ldexp(mantissa, 11);
+        if(bits != std::floor(bits)) return -1;
+        return sign | ((exponent + 14) << 10) | (uint16_t(bits) & 0x3ff);
+    }
+    // Subnormal halfs are multiples of 2^-24
+    double bits = std::ldexp(std::fabs(value), 24);
+    if(bits != std::floor(bits) || bits >= 1024) return -1;
+    return sign | uint16_t(bits);
+}
+
+static void writeDouble(std::vector<uint8_t>& out, double value) {
+    int half = toHalf(value);
+    if(half >= 0) {
+        out.push_back(0xf9);
+        out.push_back(uint8_t(half >> 8));
+        out.push_back(uint8_t(half));
+        return;
+    }
+    float single = float(value);
+    if(double(single) == value) {
+        uint32_t bits;
+        std::memcpy(&bits, &single, sizeof(bits));
+        out.push_back(0xfa);
+        for(int i = 3; i >= 0; i--) out.push_back(uint8_t(bits >> (i * 8)));
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out.push_back(0xfb);
+    for(int i = 7; i >= 0; i--) out.push_back(uint8_t(bits >> (i * 8)));
+}
+
+static void writeCBORObject(std::vector<uint8_t>& out, const json::object& object);
+static void writeCBORArray(std::vector<uint8_t>& out, const json::array& array);
+
+static void writeCBORValue(std::vector<uint8_t>& out, const json::value& value) {
+    switch(value.type) {
+        case json::JSON_OBJECT:
+            writeCBORObject(out, *value.getObject());
+            break;
+        case json::JSON_ARRAY:
+            writeCBORArray(out, *value.getArray());
+            break;
+        case json::JSON_STRING:
+            writeText(out, std::get<std::string>(value.value));
+            break;
+        case json::JSON_NUMBER: {
+            long long integer;
+            double real = 0;
+            if(value.getNumber(integer)) {
+                // Negative integers are written as -1 - n
+                if(integer >= 0) writeHead(out, 0, uint64_t(integer));
+                else writeHead(out, 1, ~uint64_t(integer));
+            } else {
+                value.getNumber(real);
+                writeDouble(out, real);
+            }
+            break;
+        }
+        case json::JSON_BOOL:
+            out.push_back(std::get<bool>(value.value) ? 0xf5 : 0xf4);
+            break;
+        case json::JSON_NULL:
+            out.push_back(0xf6);
+            break;
+    }
+}
+
+static void writeCBORObject(std::vector<uint8_t>& out, const json::object& object) {
+    writeHead(out, 5, object.data.size());
+    for(auto& [key, val]: object.data) {
+        writeText(out, key);
+        writeCBORValue(out, val);
+    }
+}
+
+static void writeCBORArray(std::vector<uint8_t>& out, const json::array& array) {
+    writeHead(out, 4, array.data.size());
+    for(auto& val: array.data) writeCBORValue(out, val);
+}
+
+void json::encodeCBOR(const json::object& object, std::vector<uint8_t>& out) {
+    writeCBORObject(out, object);
+}
+
+void json::encodeCBOR(const json::array& array, std::vector<uint8_t>& out) {
+    writeCBORArray(out, array);
+}
+
+void json::encodeCBOR(const json::value& value, std::vector<uint8_t>& out) {
+    writeCBORValue(out, value);
+}
+
+// --- Decoding ---
+
+struct cborReader {
+    const uint8_t* at;
+    const uint8_t* end;
+
+    bool read(uint64_t& out, int bytes) {
+        if(end - at < bytes) return false;
+        out = 0;
+        for(int i = 0; i < bytes; i++) out = (out << 8) | *at++;
+        return true;
+    }
+
+    // Reading the initial byte and the argument of the item.
+    // Argument of indefinite lengths and floats is left as it is in the data
+    bool head(uint8_t& major, uint8_t& info, uint64_t& argument) {
+        if(at == end) return false;
+        major = *at >> 5;
+        info = *at & 0x1f;
+        at++;
+        if(info < 24) {
+            argument = info;
+            return true;
+        }
+        switch(info) {
+            case 24: return read(argument, 1);
+            case 25: return read(argument, 2);
+            case 26: return read(argument, 4);
+            case 27: return read(argument, 8);
+            // Indefinite length, only for strings and containers
+            case 31: return major >= 2 && major <= 5;
+            default: return false;
+        }
+    }
+
+    bool text(uint8_t info, uint64_t length, std::string& out) {
+        if(info != 31) {
+            if(uint64_t(end - at) < length) return false;
+            out.append(reinterpret_cast<const char*>(at), length);
+            at += length;
+            return true;
+        }
+        // Indefinite text is a sequence of definite text chunks ended by a break
+        while(true) {
+            if(at == end) return false;
+            if(*at == 0xff) {
+                at++;
+                return true;
+            }
+            uint8_t major, chunkInfo;
+            uint64_t chunkLength;
+            if(!head(major, chunkInfo, chunkLength) || major != 3 || chunkInfo == 31) return false;
+            if(!text(chunkInfo, chunkLength, out)) return false;
+        }
+    }
+};
+
+static double fromHalf(uint16_t half) {
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double value;
+    if(exponent == 0) value = std::ldexp(mantissa, -24);
+    else if(exponent != 31) value = std::ldexp(mantissa + 1024, exponent - 25);
+    else value = mantissa == 0 ? INFINITY : NAN;
+    return (half & 0x8000) ? -value : value;
+}
+
+// Decoding one item into the builder (see parser.hpp). Containers are kept on an explicit stack,
+// so deeply nested input can't overflow the call stack.
+// root is 'o' or 'a' if the item has to be a map/array started with builder.beginRoot(), 0 for any item
+template<typename Builder> static bool decodeItem(cborReader& reader, Builder& builder, char root) {
+    struct frame {
+        uint64_t remaining;
+        bool indefinite;
+        bool map;
+        bool needKey;
+    };
+    std::vector<frame> stack;
+    std::string key;
+    bool started = false;
+    while(true) {
+        // Closing the containers that are complete
+        while(!stack.empty() && !stack.back().indefinite && stack.back().remaining == 0) {
+            if(stack.back().map) builder.endObject();
+            else builder.endArray();
+            stack.pop_back();
+        }
+        if(started && stack.empty()) return true;
+        if(reader.at == reader.end) return false;
+
+        if(!stack.empty() && stack.back().indefinite && *reader.at == 0xff) {
+            if(stack.back().map && !stack.back().needKey) return false;
+            reader.at++;
+            if(stack.back().map) builder.endObject();
+            else builder.endArray();
+            stack.pop_back();
+            continue;
+        }
+
+        uint8_t major, info;
+        uint64_t argument;
+        if(!stack.empty() && stack.back().map && stack.back().needKey) {
+            // Only text keys can be represented in the object
+            if(!reader.head(major, info, argument) || major != 3) return false;
+            key.clear();
+            if(!reader.text(info, argument, key) || !builder.key(key)) return false;
+            stack.back().needKey = false;
+            continue;
+        }
+
+        // Tags don't change how values are stored, the tagged item is decoded as it is
+        do {
+            if(!reader.head(major, info, argument)) return false;
+        } while(major == 6);
+
+        if(!started && root != 0 && major != (root == 'o' ? 5 : 4)) return false;
+        if(!stack.empty()) {
+            if(!stack.back().indefinite) stack.back().remaining--;
+            if(stack.back().map) stack.back().needKey = true;
+        }
+        bool isRoot = !started && root != 0;
+        started = true;
+
+        switch(major) {
+            case 0:
+                if(argument > uint64_t(INT64_MAX)) return false;
+                builder.value((long long)argument);
+                break;
+            case 1:
+                if(argument > uint64_t(INT64_MAX)) return false;
+                builder.value(-1 - (long long)argument);
+                break;
+            case 3: {
+                std::string text;
+                if(!reader.text(info, argument, text)) return false;
+                builder.value(std::move(text));
+                break;
+            }
+            case 4:
+            case 5:
+                if(isRoot) builder.beginRoot();
+                else if(major == 5) builder.beginObject();
+                else builder.beginArray();
+                stack.push_back({argument, info == 31, major == 5, true});
+                break;
+            case 7:
+                if(info == 20 || info == 21) builder.value(info == 21);
+                // Undefined is read as null
+                else if(info == 22 || info == 23) builder.null();
+                else if(info == 25) builder.value(fromHalf(uint16_t(argument)));
+                else if(info == 26) {
+                    uint32_t bits = uint32_t(argument);
+                    float single;
+                    std::memcpy(&single, &bits, sizeof(single));
+                    builder.value(double(single));
+                } else if(info == 27) {
+                    double value;
+                    std::memcpy(&value, &argument, sizeof(value));
+                    builder.value(value);
+                } else return false;
+                break;
+            // Byte strings have no place in the object
+            default:
+                return false;
+        }
+    }
+}
+
+bool json::decodeCBOR(const uint8_t* data, size_t size, json::object& object) {
+    cborReader reader{data, data + size};
+    domBuilder builder(object);
+    return decodeItem(reader, builder, 'o') && reader.at == reader.end;
+}
+
+bool json::decodeCBOR(const uint8_t* data, size_t size, json::array& array) {
+    cborReader reader{data, data + size};
+    domBuilder builder(array);
+    return decodeItem(reader, builder, 'a') && reader.at == reader.end;
+}
+
+bool json::decodeCBOR(const uint8_t* data, size_t size, json::value& value) {
+    cborReader reader{data, data + size};
+    json::array holder;
+    domBuilder builder(holder);
+    if(!decodeItem(reader, builder, 0) || reader.at != reader.end) return false;
+    value = std::move(holder.data[0]);
+    // Decoded object/array doesn't belong to the holder anymore
+    if(auto object = std::get_if<std::unique_ptr<json::object>>(&value.value)) (*object)->parentArray = nullptr;
+    if(auto array = std::get_if<std::unique_ptr<json::array>>(&value.value)) (*array)->parentArray = nullptr;
+    return true;
+}
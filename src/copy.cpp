@@ -0,0 +1,136 @@
+#include "parkinson.hpp"
+
+// --- Parallel copy ---
+// Big structures are copied on the calling thread level by level until their children
+// are small enough, then runs of small children are copied by the pool tasks.
+// Destination values are allocated before tasks start, so tasks only fill them in 
+
+// See object.cpp and output.cpp
+json::value copyScalar(const json::value& val);
+size_t countValueNodes(const json::value& value, size_t limit);
+
+// Child that is copied by one of the tasks
+struct copyItem {
+    const json::value* source;
+    json::value* destination;
+    json::object* parentObject;
+    json::array* parentArray;
+};
+
+struct copyPlan {
+    std::vector<std::vector<copyItem>> runs;
+    size_t runNodes = 0;
+    size_t chunkNodes;
+
+    void add(const copyItem& item, size_t nodes) {
+        if(runs.empty() || runNodes >= chunkNodes) {
+            runs.emplace_back();
+            runNodes = 0;
+        }
+        runs.back().push_back(item);
+        runNodes += nodes;
+    }
+};
+
+void planCopy(copyPlan& plan, const json::object& original, json::object& copy);
+void planCopy(copyPlan& plan, const json::array& original, json::array& copy);
+
+// Placing the child into the copy. Returns destination of the value if it has to be copied by a task
+json::value* planChild(copyPlan& plan, const json::value& val, json::value& slot, json::object* po, json::array* pa) {
+    if(val.type != json::JSON_OBJECT && val.type != json::JSON_ARRAY) {
+        slot = copyScalar(val);
+        return nullptr;
+    }
+    // Shared children stay shared (see COPY_SHARED)
+    if(auto shared = std::get_if<std::shared_ptr<const json::object>>(&val.value)) {
+        slot = json::value{ *shared, json::JSON_OBJECT };
+        return nullptr;
+    }
+    if(auto shared = std::get_if<std::shared_ptr<const json::array>>(&val.value)) {
+        slot = json::value{ *shared, json::JSON_ARRAY };
+        return nullptr;
+    }
+    size_t nodes = countValueNodes(val, plan.chunkNodes + 1);
+    if(nodes <= plan.chunkNodes) {
+        plan.add(copyItem{ &val, &slot, po, pa }, nodes);
+        return &slot;
+    }
+    // Child is too big for one task, splitting its children as well
+    if(val.type == json::JSON_OBJECT) {
+        auto child = std::make_unique<json::object>();
+        child->cacheOutput = val.getObject()->cacheOutput;
+        child->addParentObject(po);
+        child->addParentArray(pa);
+        json::object& ref = *child;
+        slot = json::value{ std::move(child), json::JSON_OBJECT };
+        planCopy(plan, *val.getObject(), ref);
+    } else {
+        auto child = std::make_unique<json::array>();
+        child->cacheOutput = val.getArray()->cacheOutput;
+        child->addParentObject(po);
+        child->addParentArray(pa);
+        json::array& ref = *child;
+        slot = json::value{ std::move(child), json::JSON_ARRAY };
+        planCopy(plan, *val.getArray(), ref);
+    }
+    return &slot;
+}
+
+void planCopy(copyPlan& plan, const json::object& original, json::object& copy) {
+    copy.data.reserve(original.data.size());
+    for(auto& [key, val]: original.data) {
+        // Elements of unordered_map don't move on insertion, so slot stays valid for the tasks
+        json::value& slot = copy.data.emplace(key, json::value{ std::monostate{}, json::JSON_NULL }).first->second;
+        planChild(plan, val, slot, &copy, nullptr);
+    }
+}
+
+void planCopy(copyPlan& plan, const json::array& original, json::array& copy) {
+    // Vector is never resized after this, so slots stay valid for the tasks
+    copy.data.resize(original.data.size());
+    for(size_t i = 0; i < original.data.size(); i++) {
+        planChild(plan, original.data[i], copy.data[i], nullptr, &copy);
+    }
+}
+
+void runCopy(copyPlan& plan, json::threadPool& pool) {
+    pool.run(plan.runs.size(), [&](size_t r) {
+        for(auto& item: plan.runs[r]) {
+            if(item.source->type == json::JSON_OBJECT) {
+                auto child = json::object::copy(*item.source->getObject());
+                child->addParentObject(item.parentObject);
+                child->addParentArray(item.parentArray);
+                *item.destination = json::value{ std::move(child), json::JSON_OBJECT };
+            } else {
+                auto child = json::array::copy(*item.source->getArray());
+                child->addParentObject(item.parentObject);
+                child->addParentArray(item.parentArray);
+                *item.destination = json::value{ std::move(child), json::JSON_ARRAY };
+            }
+        }
+    });
+}
+
+std::unique_ptr<json::object> json::object::copy(const json::object &original, json::threadPool& pool, size_t chunkNodes) {
+    if(chunkNodes == 0) chunkNodes = 1;
+    if(pool.size() < 2 || original.countNodes(2 * chunkNodes) < 2 * chunkNodes) return copy(original);
+    copyPlan plan;
+    plan.chunkNodes = chunkNodes;
+    auto object = std::make_unique<json::object>();
+    object->cacheOutput = original.cacheOutput;
+    planCopy(plan, original, *object);
+    runCopy(plan, pool);
+    return object;
+}
+
+std::unique_ptr<json::array> json::array::copy(const json::array &original, json::threadPool& pool, size_t chunkNodes) {
+    if(chunkNodes == 0) chunkNodes = 1;
+    if(pool.size() < 2 || original.countNodes(2 * chunkNodes) < 2 * chunkNodes) return copy(original);
+    copyPlan plan;
+    plan.chunkNodes = chunkNodes;
+    auto array = std::make_unique<json::array>();
+    array->cacheOutput = original.cacheOutput;
+    planCopy(plan, original, *array);
+    runCopy(plan, pool);
+    return array;
+}
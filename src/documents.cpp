@@ -0,0 +1,70 @@
+#include <optional>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// Record separator of RFC 7464, allowed before every document
+static const char RECORD_SEPARATOR = 0x1e;
+
+struct json::documentReader::state {
+    std::optional<streamSource> stream;
+    bufferSource buffer{nullptr, nullptr};
+    parserScratch scratch;
+    // Bytes taken from the source so far
+    size_t consumed = 0;
+    bool stopped = false;
+};
+
+json::documentReader::documentReader(std::istream& stream) : impl(std::make_unique<state>()) {
+    impl->stream.emplace(stream);
+}
+
+json::documentReader::documentReader(std::string_view text) : impl(std::make_unique<state>()) {
+    impl->buffer = bufferSource{text.data(), text.data() + text.size()};
+}
+
+json::documentReader::~documentReader() = default;
+
+int json::documentReader::next(json::object& out) {
+    state& s = *impl;
+    if(s.stopped) return 0;
+    // Whitespace and separators between the documents
+    char first = 0;
+    bool more = false;
+    if(s.stream) {
+        while((more = s.stream->get(first))) {
+            s.consumed++;
+            if(!isWhiteSpace(first) && first != RECORD_SEPARATOR) break;
+        }
+    } else {
+        while(s.buffer.at != s.buffer.end && (isWhiteSpace(*s.buffer.at) || *s.buffer.at == RECORD_SEPARATOR)) s.buffer.at++;
+        more = s.buffer.at != s.buffer.end;
+        s.consumed = s.buffer.at - s.buffer.begin;
+    }
+    if(!more) {
+        s.stopped = true;
+        constructExitCode(code, PARSE_SUCCESS, 0, 0);
+        return 0;
+    }
+
+    begin = s.stream ? s.consumed - 1 : s.consumed;
+    domBuilder builder(out);
+    textParser<domBuilder> parser(builder, code, s.scratch);
+    int result;
+    if(s.stream) {
+        result = parser.step(first);
+        if(result < 0) result = s.stream->feed(parser);
+    } else {
+        result = parser.feed(s.buffer.at, s.buffer.end);
+    }
+    if(result < 0) result = parser.finish();
+    end = begin + parser.offset;
+    s.consumed = end;
+    if(result == 1) return 1;
+
+    // Error is located in the whole text, not only in the document
+    s.stopped = true;
+    code.offset += begin;
+    if(s.stream) s.stream->locate(code);
+    else s.buffer.locate(code);
+    return 0;
+}
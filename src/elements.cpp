@@ -0,0 +1,171 @@
+#include <charconv>
+#include <optional>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// Builder following the path of the pointer. Values off the path are dropped as they come, elements of the array
+// at the pointer are built one at a time and the parse is paused after each of them (see textParser::feed)
+struct elementBuilder {
+    enum placement { OFF_PATH, ON_PATH, TARGET };
+    struct level {
+        bool array;
+        size_t index;
+    };
+    std::vector<std::string> tokens;
+    // Malformed pointer matches nothing, the document is just checked
+    bool valid = true;
+    // Containers from the root to the current one, while they are on the path
+    std::vector<level> path;
+    // Depth inside of the containers off the path
+    size_t skipped = 0;
+    std::string currentKey;
+    bool inTarget = false;
+    bool found = false;
+    // Element being built and its depth
+    json::array holder;
+    domBuilder dom{holder};
+    size_t building = 0;
+    json::value element;
+    bool paused = false;
+
+    // Place of the value starting in the current container of the path
+    placement place() {
+        level& top = path.back();
+        size_t depth = path.size() - 1;
+        char digits[24];
+        std::string_view name = currentKey;
+        if(top.array) name = std::string_view(digits, std::to_chars(digits, digits + sizeof(digits), top.index++).ptr - digits);
+        if(!valid || depth >= tokens.size() || tokens[depth] != name) return OFF_PATH;
+        return depth + 1 == tokens.size() ? TARGET : ON_PATH;
+    }
+
+    void takeElement() {
+        element = std::move(holder.data.back());
+        holder.data.clear();
+        detachValue(element);
+        paused = true;
+    }
+
+    void beginRoot() {
+        path.push_back({false, 0});
+    }
+
+    bool key(std::string& key) {
+        if(building > 0) return dom.key(key);
+        if(skipped == 0) currentKey = key;
+        return true;
+    }
+
+    void begin(bool array) {
+        if(building > 0 || inTarget) {
+            if(array) dom.beginArray();
+            else dom.beginObject();
+            building++;
+            return;
+        }
+        if(skipped > 0) {
+            skipped++;
+            return;
+        }
+        switch(place()) {
+            case ON_PATH:
+                path.push_back({array, 0});
+                break;
+            case TARGET:
+                // Pointer to anything but an array has no elements
+                if(array) {
+                    path.push_back({true, 0});
+                    inTarget = found = true;
+                    break;
+                }
+                [[fallthrough]];
+            case OFF_PATH:
+                skipped = 1;
+                break;
+        }
+    }
+
+    void end(bool array) {
+        if(building > 0) {
+            if(array) dom.endArray();
+            else dom.endObject();
+            if(--building == 0) takeElement();
+            return;
+        }
+        if(skipped > 0) {
+            skipped--;
+            return;
+        }
+        inTarget = false;
+        path.pop_back();
+    }
+
+    void beginObject() { begin(false); }
+    void beginArray() { begin(true); }
+    void endObject() { end(false); }
+    void endArray() { end(true); }
+
+    template<typename T> void value(T&& v) {
+        if(building > 0) dom.value(std::forward<T>(v));
+        else if(inTarget) {
+            dom.value(std::forward<T>(v));
+            takeElement();
+        } else if(skipped == 0) place();
+    }
+
+    void null() {
+        if(building > 0) dom.null();
+        else if(inTarget) {
+            dom.null();
+            takeElement();
+        } else if(skipped == 0) place();
+    }
+};
+
+struct json::arrayReader::state {
+    std::optional<streamSource> stream;
+    bufferSource buffer{nullptr, nullptr};
+    parserScratch scratch;
+    elementBuilder builder;
+    textParser<elementBuilder> parser;
+    int result = -1;
+
+    state(json::exitCode& code, std::string_view pointer) : parser(builder, code, scratch) {
+        builder.valid = splitPointer(pointer, builder.tokens);
+    }
+};
+
+json::arrayReader::arrayReader(std::istream& stream, std::string_view pointer) : impl(std::make_unique<state>(code, pointer)) {
+    impl->stream.emplace(stream);
+}
+
+json::arrayReader::arrayReader(std::string_view text, std::string_view pointer) : impl(std::make_unique<state>(code, pointer)) {
+    impl->buffer = bufferSource{text.data(), text.data() + text.size()};
+}
+
+json::arrayReader::~arrayReader() = default;
+
+int json::arrayReader::next(json::value& out) {
+    state& s = *impl;
+    if(s.result >= 0) return 0;
+    s.builder.paused = false;
+    if(s.stream) {
+        s.result = s.stream->feed(s.parser);
+    } else {
+        s.result = s.parser.feed(s.buffer.at, s.buffer.end);
+    }
+    if(s.builder.paused) {
+        out = std::move(s.builder.element);
+        return 1;
+    }
+    if(s.result < 0) s.result = s.parser.finish();
+    if(s.result == 0) {
+        if(s.stream) s.stream->locate(code);
+        else s.buffer.locate(code);
+    }
+    return 0;
+}
+
+bool json::arrayReader::found() const {
+    return impl->builder.found;
+}
@@ -0,0 +1,424 @@
+#include <cstring>
+#include <unordered_set>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// Layout of the tape. Every word has a tag in the top byte and a payload in the low 56 bits
+//   '{' / '['  start of object/array, payload is the index of the matching end word
+//   '}' / ']'  end of object/array, payload is the number of elements
+//   '"'        string, payload is the offset of the string in the string buffer
+//   'l' / 'd'  long long/double, the value is kept in the next word
+//   't' 'f' 'n' true, false, null
+// Members of an object are a key string followed by the value.
+// Strings are a 32-bit length followed by the bytes. Keys are written to the buffer only once
+
+static const uint64_t PAYLOAD_MASK = (uint64_t(1) << 56) - 1;
+
+static uint64_t makeWord(char tag, uint64_t payload) {
+    return (uint64_t(uint8_t(tag)) << 56) | payload;
+}
+
+static char tagOf(uint64_t word) {
+    return char(word >> 56);
+}
+
+static uint64_t payloadOf(uint64_t word) {
+    return word & PAYLOAD_MASK;
+}
+
+// Index of the word after the value starting at index
+static size_t skipValue(const uint64_t* tape, size_t index) {
+    switch(tagOf(tape[index])) {
+        case '{':
+        case '[':
+            return payloadOf(tape[index]) + 1;
+        case 'l':
+        case 'd':
+            return index + 2;
+        default:
+            return index + 1;
+    }
+}
+
+static std::string_view stringAt(const char* strings, uint64_t offset) {
+    uint32_t length;
+    std::memcpy(&length, strings + offset, sizeof(length));
+    return std::string_view(strings + offset + sizeof(length), length);
+}
+
+static json::types typeOf(uint64_t word) {
+    switch(tagOf(word)) {
+        case '{': return json::JSON_OBJECT;
+        case '[': return json::JSON_ARRAY;
+        case '"': return json::JSON_STRING;
+        case 'l':
+        case 'd': return json::JSON_NUMBER;
+        case 't':
+        case 'f': return json::JSON_BOOL;
+        default: return json::JSON_NULL;
+    }
+}
+
+// Document of an empty object, used by root() when there is no tape
+static const uint64_t emptyTape[2] = { makeWord('{', 1), makeWord('}', 0) };
+
+// --- Reading values of the tape ---
+
+static bool readString(const uint64_t* tape, const char* strings, size_t index, std::string_view& out) {
+    if(tagOf(tape[index]) != '"') return false;
+    out = stringAt(strings, payloadOf(tape[index]));
+    return true;
+}
+
+static bool readLong(const uint64_t* tape, size_t index, long long& out) {
+    if(tagOf(tape[index]) != 'l') return false;
+    std::memcpy(&out, &tape[index + 1], sizeof(out));
+    return true;
+}
+
+static bool readDouble(const uint64_t* tape, size_t index, double& out) {
+    if(tagOf(tape[index]) != 'd') return false;
+    std::memcpy(&out, &tape[index + 1], sizeof(out));
+    return true;
+}
+
+static bool readBool(const uint64_t* tape, size_t index, bool& out) {
+    char tag = tagOf(tape[index]);
+    if(tag != 't' && tag != 'f') return false;
+    out = tag == 't';
+    return true;
+}
+
+template<typename View> static bool readView(const uint64_t* tape, const char* strings, size_t index, char tag, View& out) {
+    if(tagOf(tape[index]) != tag) return false;
+    out.tape = tape;
+    out.strings = strings;
+    out.index = index;
+    return true;
+}
+
+// --- frozen_object ---
+
+// Index of the value of the key or 0 if there is no such key (0 is always the root '{')
+size_t json::frozen_object::find(std::string_view key) const {
+    size_t end = payloadOf(tape[index]);
+    size_t i = index + 1;
+    while(i < end) {
+        if(stringAt(strings, payloadOf(tape[i])) == key) return i + 1;
+        i = skipValue(tape, i + 1);
+    }
+    return 0;
+}
+
+size_t json::frozen_object::size() const {
+    return payloadOf(tape[payloadOf(tape[index])]);
+}
+
+bool json::frozen_object::contains(std::string_view key) const {
+    return find(key) != 0;
+}
+
+bool json::frozen_object::getType(std::string_view key, json::types &out) const {
+    size_t i = find(key);
+    if(i == 0) return false;
+    out = typeOf(tape[i]);
+    return true;
+}
+
+bool json::frozen_object::isNull(std::string_view key) const {
+    size_t i = find(key);
+    return i != 0 && tagOf(tape[i]) == 'n';
+}
+
+bool json::frozen_object::get(std::string_view key, std::string &out) const {
+    std::string_view view;
+    if(!get(key, view)) return false;
+    out = view;
+    return true;
+}
+
+bool json::frozen_object::get(std::string_view key, std::string_view &out) const {
+    size_t i = find(key);
+    return i != 0 && readString(tape, strings, i, out);
+}
+
+bool json::frozen_object::get(std::string_view key, long long &out) const {
+    size_t i = find(key);
+    return i != 0 && readLong(tape, i, out);
+}
+
+bool json::frozen_object::get(std::string_view key, double &out) const {
+    size_t i = find(key);
+    return i != 0 && readDouble(tape, i, out);
+}
+
+bool json::frozen_object::get(std::string_view key, bool &out) const {
+    size_t i = find(key);
+    return i != 0 && readBool(tape, i, out);
+}
+
+bool json::frozen_object::get(std::string_view key, json::frozen_object &out) const {
+    size_t i = find(key);
+    return i != 0 && readView(tape, strings, i, '{', out);
+}
+
+bool json::frozen_object::get(std::string_view key, json::frozen_array &out) const {
+    size_t i = find(key);
+    return i != 0 && readView(tape, strings, i, '[', out);
+}
+
+// --- frozen_array ---
+
+// Index of the element or 0 if the index is out of range
+size_t json::frozen_array::find(size_t element) const {
+    if(element >= length()) return 0;
+    size_t i = index + 1;
+    for(size_t n = 0; n < element; n++) i = skipValue(tape, i);
+    return i;
+}
+
+size_t json::frozen_array::length() const {
+    return payloadOf(tape[payloadOf(tape[index])]);
+}
+
+bool json::frozen_array::getType(size_t element, json::types &out) const {
+    size_t i = find(element);
+    if(i == 0) return false;
+    out = typeOf(tape[i]);
+    return true;
+}
+
+bool json::frozen_array::isNull(size_t element) const {
+    size_t i = find(element);
+    return i != 0 && tagOf(tape[i]) == 'n';
+}
+
+bool json::frozen_array::get(size_t element, std::string &out) const {
+    std::string_view view;
+    if(!get(element, view)) return false;
+    out = view;
+    return true;
+}
+
+bool json::frozen_array::get(size_t element, std::string_view &out) const {
+    size_t i = find(element);
+    return i != 0 && readString(tape, strings, i, out);
+}
+
+bool json::frozen_array::get(size_t element, long long &out) const {
+    size_t i = find(element);
+    return i != 0 && readLong(tape, i, out);
+}
+
+bool json::frozen_array::get(size_t element, double &out) const {
+    size_t i = find(element);
+    return i != 0 && readDouble(tape, i, out);
+}
+
+bool json::frozen_array::get(size_t element, bool &out) const {
+    size_t i = find(element);
+    return i != 0 && readBool(tape, i, out);
+}
+
+bool json::frozen_array::get(size_t element, json::frozen_object &out) const {
+    size_t i = find(element);
+    return i != 0 && readView(tape, strings, i, '{', out);
+}
+
+bool json::frozen_array::get(size_t element, json::frozen_array &out) const {
+    size_t i = find(element);
+    return i != 0 && readView(tape, strings, i, '[', out);
+}
+
+// --- Building the tape ---
+
+// Parser builder (see parser.hpp) writing the tape
+struct tapeBuilder {
+    std::vector<uint64_t> tape;
+    std::string strings;
+    // Offsets of the keys already written to the string buffer
+    std::unordered_map<std::string, uint64_t> keyOffsets;
+    // Index of the start word and number of elements of every open structure
+    std::vector<size_t> open;
+    std::vector<uint64_t> counts;
+    // Keys of the open objects, to find duplicates. Sets are reused between objects of the same depth
+    std::vector<std::unordered_set<std::string>> keys;
+    size_t objectDepth = 0;
+
+    uint64_t addString(std::string_view value) {
+        uint64_t offset = strings.size();
+        uint32_t length = value.size();
+        strings.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        strings.append(value);
+        return offset;
+    }
+
+    void begin(char tag) {
+        if(!counts.empty()) counts.back()++;
+        open.push_back(tape.size());
+        counts.push_back(0);
+        tape.push_back(makeWord(tag, 0));
+    }
+
+    void end(char tag) {
+        tape[open.back()] |= tape.size();
+        tape.push_back(makeWord(tag, counts.back()));
+        open.pop_back();
+        counts.pop_back();
+    }
+
+    void scalar(char tag) {
+        counts.back()++;
+        tape.push_back(makeWord(tag, 0));
+    }
+
+    void scalar(char tag, uint64_t bits) {
+        scalar(tag);
+        tape.push_back(bits);
+    }
+
+    void beginRoot() { beginObject(); }
+
+    void beginObject() {
+        begin('{');
+        if(keys.size() == objectDepth) keys.emplace_back();
+        keys[objectDepth++].clear();
+    }
+
+    void beginArray() { begin('['); }
+
+    void endObject() {
+        objectDepth--;
+        end('}');
+    }
+
+    void endArray() { end(']'); }
+
+    bool key(std::string& key) {
+        if(!keys[objectDepth - 1].insert(key).second) return false;
+        addKey(key);
+        return true;
+    }
+
+    void addKey(const std::string& key) {
+        auto found = keyOffsets.find(key);
+        uint64_t offset;
+        if(found != keyOffsets.end()) {
+            offset = found->second;
+        } else {
+            offset = addString(key);
+            keyOffsets.emplace(key, offset);
+        }
+        tape.push_back(makeWord('"', offset));
+    }
+
+    void value(std::string_view value) {
+        counts.back()++;
+        tape.push_back(makeWord('"', addString(value)));
+    }
+
+    void value(std::string&& value) { this->value(std::string_view(value)); }
+
+    void value(long long value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        scalar('l', bits);
+    }
+
+    void value(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        scalar('d', bits);
+    }
+
+    void value(bool value) { scalar(value ? 't' : 'f'); }
+
+    void null() { scalar('n'); }
+
+    // Copying the tape and the strings into one block of memory
+    void finish(json::frozen_document& document) {
+        size_t stringWords = (strings.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        std::shared_ptr<uint64_t[]> block = std::make_shared_for_overwrite<uint64_t[]>(tape.size() + stringWords);
+        std::memcpy(block.get(), tape.data(), tape.size() * sizeof(uint64_t));
+        std::memcpy(block.get() + tape.size(), strings.data(), strings.size());
+        document.tape = block.get();
+        document.tapeWords = tape.size();
+        document.strings = reinterpret_cast<const char*>(block.get() + tape.size());
+        document.stringBytes = strings.size();
+        document.storage = std::move(block);
+    }
+};
+
+// Writing the object to the builder. Keys of unordered_map are unique already
+static void freezeObject(tapeBuilder& builder, const json::object& object);
+static void freezeArray(tapeBuilder& builder, const json::array& array);
+
+static void freezeValue(tapeBuilder& builder, const json::value& value) {
+    switch(value.type) {
+        case json::JSON_OBJECT:
+            builder.begin('{');
+            freezeObject(builder, *value.getObject());
+            builder.end('}');
+            break;
+        case json::JSON_ARRAY:
+            builder.begin('[');
+            freezeArray(builder, *value.getArray());
+            builder.end(']');
+            break;
+        case json::JSON_STRING:
+            builder.value(std::string_view(std::get<std::string>(value.value)));
+            break;
+        case json::JSON_NUMBER: {
+            long long integer;
+            double real = 0;
+            if(value.getNumber(integer)) builder.value(integer);
+            else {
+                value.getNumber(real);
+                builder.value(real);
+            }
+            break;
+        }
+        case json::JSON_BOOL:
+            builder.value(std::get<bool>(value.value));
+            break;
+        case json::JSON_NULL:
+            builder.null();
+            break;
+    }
+}
+
+static void freezeObject(tapeBuilder& builder, const json::object& object) {
+    for(auto& [key, val]: object.data) {
+        builder.addKey(key);
+        freezeValue(builder, val);
+    }
+}
+
+static void freezeArray(tapeBuilder& builder, const json::array& array) {
+    for(auto& val: array.data) freezeValue(builder, val);
+}
+
+// --- frozen_document ---
+
+json::frozen_document::frozen_document(const json::object& object) {
+    tapeBuilder builder;
+    builder.begin('{');
+    freezeObject(builder, object);
+    builder.end('}');
+    builder.finish(*this);
+}
+
+json::frozen_object json::frozen_document::root() const {
+    json::frozen_object root;
+    root.tape = tape != nullptr ? tape : emptyTape;
+    root.strings = strings;
+    root.index = 0;
+    return root;
+}
+
+int json::parse(std::istream &stream, json::frozen_document& document, json::exitCode& code) {
+    tapeBuilder builder;
+    if(!parseText(stream, builder, code)) return 0;
+    builder.finish(document);
+    return 1;
+}
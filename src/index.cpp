@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// --- Structural index ---
+// Text is read in blocks of 64 bytes, every block gives bitmaps of its quotes, backslashes and structural characters.
+// Quote state of the chunk depends on the chunks before it, so chunks are read twice:
+// first for the number of quotes, then, with the state known, for the positions
+
+struct blockBits {
+    uint64_t quotes = 0;
+    uint64_t backslashes = 0;
+    uint64_t structurals = 0;
+};
+
+// Bits of 64 flags that are 0 or 1. Multiplying moves the flag of every byte of the word to its own bit of the top byte
+static uint64_t packFlags(const uint8_t* flags) {
+    uint64_t bits = 0;
+    for(int i = 0; i < 8; i++) {
+        uint64_t word = 0;
+        for(int j = 0; j < 8; j++) word |= uint64_t(flags[i * 8 + j]) << (j * 8);
+        bits |= ((word * 0x0102040810204080ULL) >> 56) << (i * 8);
+    }
+    return bits;
+}
+
+// Flags are compared without tables, so the loop is vectorized.
+// '[' and ']' differ from '{' and '}' only by the bit 0x20
+static blockBits classifyBlock(const char* block) {
+    uint8_t quotes[64], backslashes[64], structurals[64];
+    for(int i = 0; i < 64; i++) {
+        uint8_t ch = block[i];
+        uint8_t bracket = ch | 0x20;
+        quotes[i] = ch == '"';
+        backslashes[i] = ch == '\\';
+        structurals[i] = (bracket == '{') | (bracket == '}') | (ch == ':') | (ch == ',');
+    }
+    return {packFlags(quotes), packFlags(backslashes), packFlags(structurals)};
+}
+
+// Characters escaped by the backslashes before them: the ones after the runs of odd length.
+// carry is set when the last backslash of the block escapes the first character of the next one
+static uint64_t findEscaped(uint64_t backslashes, uint64_t& carry) {
+    const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+    backslashes &= ~carry;
+    uint64_t followsEscape = backslashes << 1 | carry;
+    uint64_t oddStarts = backslashes & ~EVEN_BITS & ~followsEscape;
+    // Adding the starts carries through the runs, so the run ends where the sum flips the bit
+    uint64_t evenStarts = oddStarts + backslashes;
+    carry = evenStarts < oddStarts;
+    uint64_t invert = evenStarts << 1;
+    return (EVEN_BITS ^ invert) & followsEscape;
+}
+
+// Bit i is set if there is an odd number of bits up to and including i
+static uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Walking the blocks of the chunk, the last block is padded with spaces
+template<typename Fn> static void forEachBlock(std::string_view text, size_t from, size_t to, Fn&& fn) {
+    for(size_t at = from; at < to; at += 64) {
+        if(to - at >= 64) {
+            fn(at, classifyBlock(text.data() + at));
+            continue;
+        }
+        char block[64];
+        std::memset(block, ' ', sizeof(block));
+        std::memcpy(block, text.data() + at, to - at);
+        fn(at, classifyBlock(block));
+    }
+}
+
+// First character of the chunk is escaped if an odd run of backslashes ends right before it
+static uint64_t escapeBefore(std::string_view text, size_t from) {
+    size_t count = 0;
+    while(from > count && text[from - count - 1] == '\\') count++;
+    return count & 1;
+}
+
+void structuralScanner::scan(std::string_view text, size_t from, size_t to, std::vector<uint32_t>& positions) {
+    forEachBlock(text, from, to, [&](size_t at, const blockBits& bits) {
+        uint64_t quotes = bits.quotes & ~findEscaped(bits.backslashes, escaped);
+        // Opening quotes and the characters of strings are set, closing quotes aren't
+        uint64_t strings = prefixXor(quotes) ^ inString;
+        inString = uint64_t(int64_t(strings) >> 63);
+        uint64_t found = (bits.structurals & ~strings) | quotes;
+        uint32_t base = uint32_t(at - from);
+        while(found != 0) {
+            positions.push_back(base + std::countr_zero(found));
+            found &= found - 1;
+        }
+    });
+}
+
+void buildStructuralIndex(std::string_view text, json::threadPool& pool, size_t chunkBytes, structuralIndex& index) {
+    // Chunks are made of whole blocks, positions inside of them fit 32 bits
+    chunkBytes = std::clamp<size_t>((chunkBytes + 63) / 64 * 64, 64, size_t(1) << 31);
+    size_t count = (text.size() + chunkBytes - 1) / chunkBytes;
+    index.chunkBytes = chunkBytes;
+    index.chunks.assign(count, {});
+
+    // Chunks with an odd number of quotes flip the state of the ones after them
+    std::vector<uint8_t> oddQuotes(count);
+    pool.run(count, [&](size_t chunk) {
+        size_t from = chunk * chunkBytes;
+        uint64_t carry = escapeBefore(text, from);
+        int quotes = 0;
+        forEachBlock(text, from, std::min(text.size(), from + chunkBytes), [&](size_t, const blockBits& bits) {
+            quotes += std::popcount(bits.quotes & ~findEscaped(bits.backslashes, carry));
+        });
+        oddQuotes[chunk] = quotes & 1;
+    });
+    std::vector<uint8_t> inString(count);
+    for(size_t chunk = 1; chunk < count; chunk++) inString[chunk] = inString[chunk - 1] ^ oddQuotes[chunk - 1];
+
+    pool.run(count, [&](size_t chunk) {
+        size_t from = chunk * chunkBytes;
+        structuralScanner scanner;
+        scanner.escaped = escapeBefore(text, from);
+        scanner.inString = inString[chunk] ? ~uint64_t(0) : 0;
+        scanner.scan(text, from, std::min(text.size(), from + chunkBytes), index.chunks[chunk]);
+    });
+}
+
+// --- Building the object from the index ---
+// Values between the positions are read in a single pass. Only the plain grammar is accepted,
+// anything else makes the caller parse the text the usual way, so errors are reported the same
+
+static bool isBlank(std::string_view text, size_t from, size_t to) {
+    for(; from < to; from++) {
+        if(!isWhiteSpace(text[from])) return false;
+    }
+    return true;
+}
+
+// Numbers, booleans and null are everything between the positions except the whitespace around them
+static bool scalarValue(std::string_view scalar, domBuilder& builder, std::string& tmpVal) {
+    for(char ch: scalar) {
+        if(isWhiteSpace(ch)) return false;
+    }
+    json::types type;
+    if(detectValueType(scalar[0], type) != json::PARSE_SUCCESS) return false;
+    switch(type) {
+        case json::JSON_BOOL:
+            if(scalar != "true" && scalar != "false") return false;
+            builder.value(scalar == "true");
+            return true;
+        case json::JSON_NULL:
+            if(scalar != "null") return false;
+            builder.null();
+            return true;
+        case json::JSON_NUMBER: {
+            tmpVal.assign(scalar);
+            bool whole = false;
+            if(!checkNumber(tmpVal, whole)) return false;
+            if(whole) {
+                builder.value(readWhole(tmpVal));
+                return true;
+            }
+            double d;
+            if(!readReal(tmpVal, d)) return false;
+            builder.value(d);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool buildFromIndex(std::string_view text, const structuralIndex& index, domBuilder& builder, parserScratch& scratch) {
+    enum { KEY_OR_END, KEY, VALUE_OR_END, VALUE, AFTER_VALUE } state = KEY_OR_END;
+    indexCursor cursor{index};
+    std::string& context = scratch.context;
+    context.clear();
+    uint64_t position;
+    if(!cursor.next(position) || text[position] != '{' || !isBlank(text, 0, position)) return false;
+    builder.beginRoot();
+    context.push_back('o');
+    // First byte after the last read token
+    size_t end = position + 1;
+    bool pending = false;
+    while(true) {
+        if(!pending && !cursor.next(position)) return false;
+        pending = false;
+        char ch = text[position];
+        bool blank = isBlank(text, end, position);
+        switch(state) {
+            case KEY_OR_END:
+            case KEY: {
+                if(!blank) return false;
+                if(ch == '}' && state == KEY_OR_END) break;
+                uint64_t close, colon;
+                if(ch != '"' || !cursor.next(close) || !cursor.next(colon)) return false;
+                if(text[close] != '"' || text[colon] != ':' || !isBlank(text, close + 1, colon)) return false;
+                scratch.tmpKey.assign(text.data() + position + 1, close - position - 1);
+                scratch.key.clear();
+                if(!processString(scratch.tmpKey, scratch.key) || !builder.key(scratch.key)) return false;
+                end = colon + 1;
+                state = VALUE;
+                continue;
+            }
+            case VALUE_OR_END:
+            case VALUE: {
+                if(!blank) {
+                    size_t from = end;
+                    while(isWhiteSpace(text[from])) from++;
+                    size_t to = position;
+                    while(isWhiteSpace(text[to - 1])) to--;
+                    if(!scalarValue(text.substr(from, to - from), builder, scratch.tmpVal)) return false;
+                    end = to;
+                    // Position after the scalar is read again as the end of the value
+                    state = AFTER_VALUE;
+                    pending = true;
+                    continue;
+                }
+                if(ch == ']' && state == VALUE_OR_END) break;
+                if(ch == '"') {
+                    uint64_t close;
+                    if(!cursor.next(close) || text[close] != '"') return false;
+                    scratch.tmpVal.assign(text.data() + position + 1, close - position - 1);
+                    scratch.processed.clear();
+                    if(!processString(scratch.tmpVal, scratch.processed)) return false;
+                    builder.value(std::move(scratch.processed));
+                    end = close + 1;
+                    state = AFTER_VALUE;
+                } else if(ch == '{') {
+                    builder.beginObject();
+                    context.push_back('o');
+                    end = position + 1;
+                    state = KEY_OR_END;
+                } else if(ch == '[') {
+                    builder.beginArray();
+                    context.push_back('a');
+                    end = position + 1;
+                    state = VALUE_OR_END;
+                } else return false;
+                continue;
+            }
+            case AFTER_VALUE:
+                if(!blank) return false;
+                if(ch == ',') {
+                    end = position + 1;
+                    state = context.back() == 'o' ? KEY : VALUE;
+                    continue;
+                }
+                if(ch != (context.back() == 'o' ? '}' : ']')) return false;
+                break;
+        }
+        // Closing the container at the position, rest of the text after the root is ignored as by the parser
+        if(context.back() == 'o') builder.endObject();
+        else builder.endArray();
+        context.pop_back();
+        if(context.empty()) return true;
+        end = position + 1;
+        state = AFTER_VALUE;
+    }
+}
+
+int json::parseParallel(std::string_view text, json::object& object, json::exitCode& code, json::threadPool& pool, size_t chunkBytes) {
+    if(text.size() <= chunkBytes) return json::parse(text, object, code);
+    thread_local parserScratch scratch;
+    structuralIndex index;
+    buildStructuralIndex(text, pool, chunkBytes, index);
+    domBuilder builder(object);
+    if(buildFromIndex(text, index, builder, scratch)) {
+        constructExitCode(code, PARSE_SUCCESS, 0, 0);
+        return 1;
+    }
+    // Parser finds the error and its place
+    object.invalidate();
+    object.data.clear();
+    return json::parse(text, object, code);
+}
+
+int json::parseParallel(std::string_view text, json::object& object, json::exitCode& code, unsigned threads, size_t chunkBytes) {
+    if(threads == 0) return parseParallel(text, object, code, json::threadPool::shared(), chunkBytes);
+    json::threadPool pool(threads);
+    return parseParallel(text, object, code, pool, chunkBytes);
+}
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "parkinson.hpp"
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define PARKINSON_IO_URING 1
+#endif
+
+// Files go through two stages: readers load whole files into memory, parser threads parse them and call the callback.
+// Bytes of the files that are loaded but not parsed yet are limited by the budget, readers wait when it is used up
+
+struct loadedFile {
+    size_t index;
+    std::unique_ptr<char[]> data;
+    size_t size;
+    bool ok;
+};
+
+// Memory limit shared by the readers and the parsers
+struct byteBudget {
+    size_t limit;
+    size_t used = 0;
+    std::mutex lock;
+    std::condition_variable released;
+
+    // File bigger than the whole budget is still loaded when nothing else is
+    bool fits(size_t size) const {
+        return used == 0 || used + size <= limit;
+    }
+    bool tryAcquire(size_t size) {
+        std::lock_guard<std::mutex> guard(lock);
+        if(!fits(size)) return false;
+        used += size;
+        return true;
+    }
+    void acquire(size_t size) {
+        std::unique_lock<std::mutex> guard(lock);
+        released.wait(guard, [&] { return fits(size); });
+        used += size;
+    }
+    void release(size_t size) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            used -= size;
+        }
+        released.notify_all();
+    }
+};
+
+// Loaded files waiting for the parsers
+struct fileQueue {
+    std::deque<loadedFile> files;
+    bool closed = false;
+    std::mutex lock;
+    std::condition_variable ready;
+
+    void push(loadedFile&& file) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            files.push_back(std::move(file));
+        }
+        ready.notify_one();
+    }
+    // false when the queue is closed and empty
+    bool pop(loadedFile& file) {
+        std::unique_lock<std::mutex> guard(lock);
+        ready.wait(guard, [&] { return closed || !files.empty(); });
+        if(files.empty()) return false;
+        file = std::move(files.front());
+        files.pop_front();
+        return true;
+    }
+    void close() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+};
+
+static bool fileSize(const std::string& path, size_t& size) {
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return false;
+    size = info.st_size;
+    return true;
+}
+
+// Reading the rest of the file with pread, from done to size. Size is cut if the file became shorter
+static bool readRest(int fd, char* data, size_t& size, size_t done) {
+    while(done < size) {
+        ssize_t got = pread(fd, data + done, size - done, done);
+        if(got < 0 && errno == EINTR) continue;
+        if(got < 0) return false;
+        if(got == 0) break;
+        done += got;
+    }
+    size = done;
+    return true;
+}
+
+// --- pread fallback ---
+
+// Every reader thread loads files one after another with pread, starting from the file first
+static void readWithThreads(const std::vector<std::string>& paths, size_t first, fileQueue& queue, byteBudget& budget, unsigned threads) {
+    std::atomic<size_t> next = first;
+    auto reader = [&] {
+        while(true) {
+            size_t index = next.fetch_add(1);
+            if(index >= paths.size()) return;
+            loadedFile file{index, nullptr, 0, false};
+            if(fileSize(paths[index], file.size)) {
+                budget.acquire(file.size);
+                int fd = open(paths[index].c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd >= 0) {
+                    size_t reserved = file.size;
+                    file.data = std::make_unique_for_overwrite<char[]>(file.size);
+                    file.ok = readRest(fd, file.data.get(), file.size, 0);
+                    close(fd);
+                    // Budget is released by the parser, for the size that was reserved
+                    if(reserved != file.size) budget.release(reserved - file.size);
+                } else {
+                    budget.release(file.size);
+                    file.size = 0;
+                }
+            }
+            queue.push(std::move(file));
+        }
+    };
+    std::vector<std::thread> readers;
+    for(unsigned i = 1; i < threads; i++) readers.emplace_back(reader);
+    reader();
+    for(auto& thread: readers) thread.join();
+}
+
+// --- io_uring ---
+
+#ifdef PARKINSON_IO_URING
+// Submission and completion rings, used through the system calls directly
+struct uring {
+    int fd = -1;
+    unsigned entries = 0;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+    // Entries added to the ring but not submitted to the kernel yet
+    unsigned unsubmitted = 0;
+
+    bool setup(unsigned depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = syscall(__NR_io_uring_setup, depth, &params);
+        if(fd < 0) return false;
+        entries = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if(sqRing == MAP_FAILED) return false;
+        cqRing = single ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(cqRing == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if(sqes == MAP_FAILED) return false;
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    ~uring() {
+        if(sqes != MAP_FAILED) munmap(sqes, entries * sizeof(io_uring_sqe));
+        if(cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if(fd >= 0) close(fd);
+    }
+
+    // Adding the read to the ring. Caller keeps at most entries reads in flight, so the ring never overflows
+    void read(int file, char* data, size_t size, size_t offset, uint64_t tag) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = file;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        // Reads are limited to 1 GB, the rest is read by the next submission
+        sqe.len = std::min<size_t>(size, 1 << 30);
+        sqe.off = offset;
+        sqe.user_data = tag;
+        sqArray[index] = index;
+        std::atomic_ref<unsigned>(*sqTail).store(tail + 1, std::memory_order_release);
+        unsubmitted++;
+    }
+
+    // Submitting the new reads and waiting for at least one completion
+    bool wait() {
+        while(true) {
+            int submitted = syscall(__NR_io_uring_enter, fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(submitted >= 0) {
+                unsubmitted -= submitted;
+                return true;
+            }
+            // Completion queue is full, reaping the completions makes room
+            if(errno == EAGAIN || errno == EBUSY) return true;
+            if(errno != EINTR) return false;
+        }
+    }
+
+    // Waiting for count completions without submitting anything, their results are dropped
+    bool drain(unsigned count) {
+        while(count > 0) {
+            int result = syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+            reap([&](uint64_t, int) { count--; });
+        }
+        return true;
+    }
+
+    // Calling fn(tag, result) for every completion
+    template<typename Fn> void reap(Fn fn) {
+        unsigned head = *cqHead;
+        unsigned tail = std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire);
+        while(head != tail) {
+            io_uring_cqe& cqe = cqes[head & *cqMask];
+            uint64_t tag = cqe.user_data;
+            int result = cqe.res;
+            head++;
+            std::atomic_ref<unsigned>(*cqHead).store(head, std::memory_order_release);
+            fn(tag, result);
+        }
+    }
+};
+
+// Keeping up to depth reads in flight on the ring of the calling thread.
+// Returns false if the ring can't be used, nothing is read then
+static bool readWithUring(const std::vector<std::string>& paths, fileQueue& queue, byteBudget& budget, unsigned depth) {
+    uring ring;
+    if(!ring.setup(depth)) return false;
+    depth = std::min(depth, ring.entries);
+
+    struct slot {
+        int fd;
+        loadedFile file;
+        size_t done;
+    };
+    std::vector<slot> slots(depth);
+    std::vector<unsigned> freeSlots;
+    for(unsigned i = depth; i > 0; i--) freeSlots.push_back(i - 1);
+
+    auto finish = [&](slot& s, bool ok) {
+        close(s.fd);
+        if(!ok) {
+            budget.release(s.file.size);
+            s.file.size = 0;
+        } else if(s.done < s.file.size) {
+            budget.release(s.file.size - s.done);
+            s.file.size = s.done;
+        }
+        s.file.ok = ok;
+        queue.push(std::move(s.file));
+    };
+
+    size_t next = 0;
+    unsigned inFlight = 0;
+    while(next < paths.size() || inFlight > 0) {
+        while(next < paths.size() && !freeSlots.empty()) {
+            loadedFile file{next, nullptr, 0, false};
+            if(!fileSize(paths[next], file.size)) {
+                queue.push(std::move(file));
+                next++;
+                continue;
+            }
+            // Waiting for the memory only when there are no reads to complete
+            if(inFlight > 0) {
+                if(!budget.tryAcquire(file.size)) break;
+            } else {
+                budget.acquire(file.size);
+            }
+            next++;
+            int fd = open(paths[file.index].c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0) {
+                budget.release(file.size);
+                file.size = 0;
+                queue.push(std::move(file));
+                continue;
+            }
+            file.data = std::make_unique_for_overwrite<char[]>(file.size);
+            if(file.size == 0) {
+                close(fd);
+                file.ok = true;
+                queue.push(std::move(file));
+                continue;
+            }
+            unsigned index = freeSlots.back();
+            freeSlots.pop_back();
+            slots[index] = slot{fd, std::move(file), 0};
+            ring.read(fd, slots[index].file.data.get(), slots[index].file.size, 0, index);
+            inFlight++;
+        }
+        if(inFlight == 0) continue;
+        if(!ring.wait()) {
+            // Ring stopped working, the reads in flight are finished with pread. Every slot in flight has one read
+            // in the ring, the submitted ones may still write into the buffers until they complete
+            bool drained = ring.drain(inFlight - ring.unsubmitted);
+            std::vector<bool> busy(depth, true);
+            for(unsigned i: freeSlots) busy[i] = false;
+            for(unsigned i = 0; i < depth; i++) {
+                if(!busy[i]) continue;
+                slot& s = slots[i];
+                if(!drained) {
+                    // Buffer is left to the kernel, the file is read into a new one
+                    s.file.data.release();
+                    s.file.data = std::make_unique_for_overwrite<char[]>(s.file.size);
+                }
+                size_t size = s.file.size;
+                bool ok = readRest(s.fd, s.file.data.get(), size, 0);
+                s.done = size;
+                finish(s, ok);
+            }
+            readWithThreads(paths, next, queue, budget, 1);
+            return true;
+        }
+        ring.reap([&](uint64_t tag, int result) {
+            slot& s = slots[tag];
+            if(result == -EINTR || result == -EAGAIN) {
+                ring.read(s.fd, s.file.data.get() + s.done, s.file.size - s.done, s.done, tag);
+                return;
+            }
+            bool done;
+            bool ok = true;
+            if(result == -EINVAL || result == -EOPNOTSUPP) {
+                // Kernel doesn't support reads on the ring
+                size_t size = s.file.size;
+                ok = readRest(s.fd, s.file.data.get(), size, s.done);
+                s.done = size;
+                done = true;
+            } else if(result < 0) {
+                ok = false;
+                done = true;
+            } else {
+                s.done += result;
+                // File ended early or is read completely
+                done = result == 0 || s.done == s.file.size;
+            }
+            if(!done) {
+                ring.read(s.fd, s.file.data.get() + s.done, s.file.size - s.done, s.done, tag);
+                return;
+            }
+            finish(s, ok);
+            freeSlots.push_back(tag);
+            inFlight--;
+        });
+    }
+    return true;
+}
+#endif
+
+size_t json::ingestFiles(const std::vector<std::string>& paths, const std::function<void(size_t index, std::unique_ptr<json::object> object, const json::exitCode& code)>& callback, const json::ingestConfig& config) {
+    fileQueue queue;
+    byteBudget budget;
+    budget.limit = config.maxBufferedBytes;
+    std::atomic<size_t> parsed = 0;
+
+    unsigned parsers = config.parserThreads;
+    if(parsers == 0) parsers = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < parsers; i++) {
+        workers.emplace_back([&] {
+            loadedFile file;
+            while(queue.pop(file)) {
+                auto object = std::make_unique<json::object>();
+                json::exitCode code;
+                if(!file.ok) {
+                    code.returnCode = json::PARSE_ERR_IO;
+                    code.message = "PARSE_ERR_IO";
+                } else if(json::parse(std::string_view(file.data.get(), file.size), *object, code)) {
+                    parsed.fetch_add(1, std::memory_order_relaxed);
+                }
+                // Text is not needed anymore, readers can load the next files
+                file.data.reset();
+                budget.release(file.size);
+                callback(file.index, std::move(object), code);
+            }
+        });
+    }
+
+    unsigned depth = std::max(1u, config.readsInFlight);
+    bool done = false;
+#ifdef PARKINSON_IO_URING
+    if(config.useIoUring) done = readWithUring(paths, queue, budget, depth);
+#endif
+    if(!done) readWithThreads(paths, 0, queue, budget, depth);
+
+    queue.close();
+    for(auto& worker: workers) worker.join();
+    return parsed.load();
+}
@@ -0,0 +1,488 @@
+#include <cstring>
+#include <optional>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// MessagePack. Objects are maps with str keys, numbers are ints or floats, null is nil.
+// Integers and lengths are written in their smallest form, doubles as float 32 when that keeps the value
+
+// --- Encoding ---
+
+static void writeBig(std::vector<uint8_t>& out, uint8_t marker, uint64_t value, int bytes) {
+    out.push_back(marker);
+    for(int i = bytes - 1; i >= 0; i--) out.push_back(uint8_t(value >> (i * 8)));
+}
+
+static void writeInteger(std::vector<uint8_t>& out, long long value) {
+    if(value >= 0) {
+        if(value < 0x80) out.push_back(uint8_t(value));
+        else if(value <= 0xff) writeBig(out, 0xcc, value, 1);
+        else if(value <= 0xffff) writeBig(out, 0xcd, value, 2);
+        else if(value <= 0xffffffffLL) writeBig(out, 0xce, value, 4);
+        else writeBig(out, 0xcf, value, 8);
+    } else {
+        if(value >= -32) out.push_back(uint8_t(value));
+        else if(value >= INT8_MIN) writeBig(out, 0xd0, uint64_t(value), 1);
+        else if(value >= INT16_MIN) writeBig(out, 0xd1, uint64_t(value), 2);
+        else if(value >= INT32_MIN) writeBig(out, 0xd2, uint64_t(value), 4);
+        else writeBig(out, 0xd3, uint64_t(value), 8);
+    }
+}
+
+static void writeDouble(std::vector<uint8_t>& out, double value) {
+    float single = float(value);
+    // NaN never equals itself, so it is written as float 64
+    if(double(single) == value) {
+        uint32_t bits;
+        std::memcpy(&bits, &single, sizeof(bits));
+        writeBig(out, 0xca, bits, 4);
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeBig(out, 0xcb, bits, 8);
+}
+
+// Sizes are at most 32-bit in MessagePack, false if the size doesn't fit
+static bool writeString(std::vector<uint8_t>& out, const std::string& value) {
+    size_t size = value.size();
+    if(size > 0xffffffffULL) return false;
+    if(size < 32) out.push_back(uint8_t(0xa0 | size));
+    else if(size <= 0xff) writeBig(out, 0xd9, size, 1);
+    else if(size <= 0xffff) writeBig(out, 0xda, size, 2);
+    else writeBig(out, 0xdb, size, 4);
+    out.insert(out.end(), value.begin(), value.end());
+    return true;
+}
+
+// fix marker is used for sizes below 16, then 16 and 32-bit sizes
+static bool writeContainer(std::vector<uint8_t>& out, uint8_t fix, uint8_t marker16, size_t size) {
+    if(size > 0xffffffffULL) return false;
+    if(size < 16) out.push_back(uint8_t(fix | size));
+    else if(size <= 0xffff) writeBig(out, marker16, size, 2);
+    else writeBig(out, marker16 + 1, size, 4);
+    return true;
+}
+
+static bool writeMsgPackObject(std::vector<uint8_t>& out, const json::object& object);
+static bool writeMsgPackArray(std::vector<uint8_t>& out, const json::array& array);
+
+static bool writeMsgPackValue(std::vector<uint8_t>& out, const json::value& value) {
+    switch(value.type) {
+        case json::JSON_OBJECT:
+            return writeMsgPackObject(out, *value.getObject());
+        case json::JSON_ARRAY:
+            return writeMsgPackArray(out, *value.getArray());
+        case json::JSON_STRING:
+            return writeString(out, std::get<std::string>(value.value));
+        case json::JSON_NUMBER: {
+            long long integer;
+            double real = 0;
+            if(value.getNumber(integer)) writeInteger(out, integer);
+            else {
+                value.getNumber(real);
+                writeDouble(out, real);
+            }
+            break;
+        }
+        case json::JSON_BOOL:
+            out.push_back(std::get<bool>(value.value) ? 0xc3 : 0xc2);
+            break;
+        case json::JSON_NULL:
+            out.push_back(0xc0);
+            break;
+    }
+    return true;
+}
+
+static bool writeMsgPackObject(std::vector<uint8_t>& out, const json::object& object) {
+    if(!writeContainer(out, 0x80, 0xde, object.data.size())) return false;
+    for(auto& [key, val]: object.data) {
+        if(!writeString(out, key) || !writeMsgPackValue(out, val)) return false;
+    }
+    return true;
+}
+
+static bool writeMsgPackArray(std::vector<uint8_t>& out, const json::array& array) {
+    if(!writeContainer(out, 0x90, 0xdc, array.data.size())) return false;
+    for(auto& val: array.data) {
+        if(!writeMsgPackValue(out, val)) return false;
+    }
+    return true;
+}
+
+// Data written before the failure is dropped
+template<typename T> static bool encode(const T& data, std::vector<uint8_t>& out, bool (*write)(std::vector<uint8_t>&, const T&)) {
+    size_t size = out.size();
+    if(write(out, data)) return true;
+    out.resize(size);
+    return false;
+}
+
+bool json::encodeMsgPack(const json::object& object, std::vector<uint8_t>& out) {
+    return encode(object, out, writeMsgPackObject);
+}
+
+bool json::encodeMsgPack(const json::array& array, std::vector<uint8_t>& out) {
+    return encode(array, out, writeMsgPackArray);
+}
+
+bool json::encodeMsgPack(const json::value& value, std::vector<uint8_t>& out) {
+    return encode(value, out, writeMsgPackValue);
+}
+
+// --- Decoding ---
+
+enum decodeStatus {
+    DECODE_DONE,
+    // Data ended in the middle of the item
+    DECODE_INCOMPLETE,
+    DECODE_INVALID,
+    // Handler asked to stop
+    DECODE_STOPPED,
+};
+
+// Receivers of the decoded data. Every callback returns false to stop the decoding
+
+// Writing into the object/array/value (see domBuilder)
+struct domReceiver {
+    domBuilder builder;
+    std::string key;
+    template<typename Root> domReceiver(Root& root) : builder(root) {}
+    bool beginRoot(size_t) { builder.beginRoot(); return true; }
+    bool beginObject(size_t) { builder.beginObject(); return true; }
+    bool beginArray(size_t) { builder.beginArray(); return true; }
+    bool endObject() { builder.endObject(); return true; }
+    bool endArray() { builder.endArray(); return true; }
+    bool onKey(std::string_view value) {
+        key.assign(value);
+        return builder.key(key);
+    }
+    bool onString(std::string_view value) { builder.value(std::string(value)); return true; }
+    bool onInteger(long long value) { builder.value(value); return true; }
+    bool onDouble(double value) { builder.value(value); return true; }
+    bool onBool(bool value) { builder.value(value); return true; }
+    bool onNull() { builder.null(); return true; }
+};
+
+// Passing the data to the user's handler
+struct handlerReceiver {
+    json::msgpackHandler& handler;
+    bool beginRoot(size_t size) { return handler.beginObject(size); }
+    bool beginObject(size_t size) { return handler.beginObject(size); }
+    bool beginArray(size_t size) { return handler.beginArray(size); }
+    bool endObject() { return handler.endObject(); }
+    bool endArray() { return handler.endArray(); }
+    bool onKey(std::string_view value) { return handler.key(value); }
+    bool onString(std::string_view value) { return handler.value(value); }
+    bool onInteger(long long value) { return handler.value(value); }
+    bool onDouble(double value) { return handler.value(value); }
+    bool onBool(bool value) { return handler.value(value); }
+    bool onNull() { return handler.null(); }
+};
+
+// Only checking that the item is complete and valid
+struct skipReceiver {
+    bool beginRoot(size_t) { return true; }
+    bool beginObject(size_t) { return true; }
+    bool beginArray(size_t) { return true; }
+    bool endObject() { return true; }
+    bool endArray() { return true; }
+    bool onKey(std::string_view) { return true; }
+    bool onString(std::string_view) { return true; }
+    bool onInteger(long long) { return true; }
+    bool onDouble(double) { return true; }
+    bool onBool(bool) { return true; }
+    bool onNull() { return true; }
+};
+
+struct msgpackReader {
+    const uint8_t* at;
+    const uint8_t* end;
+
+    bool read(uint64_t& out, int bytes) {
+        if(end - at < bytes) return false;
+        out = 0;
+        for(int i = 0; i < bytes; i++) out = (out << 8) | *at++;
+        return true;
+    }
+
+    bool bytes(uint64_t size, std::string_view& out) {
+        if(uint64_t(end - at) < size) return false;
+        out = std::string_view(reinterpret_cast<const char*>(at), size);
+        at += size;
+        return true;
+    }
+};
+
+// Reading str of any size, marker is already read
+static decodeStatus readString(msgpackReader& reader, uint8_t marker, std::string_view& out) {
+    uint64_t size;
+    if(marker >= 0xa0 && marker <= 0xbf) size = marker & 0x1f;
+    else if(marker == 0xd9 || marker == 0xda || marker == 0xdb) {
+        if(!reader.read(size, 1 << (marker - 0xd9))) return DECODE_INCOMPLETE;
+    } else return DECODE_INVALID;
+    return reader.bytes(size, out) ? DECODE_DONE : DECODE_INCOMPLETE;
+}
+
+// Containers of the item being decoded, kept by msgpackStream between the pieces of data
+struct decodeFrame {
+    uint64_t remaining;
+    bool map;
+    bool needKey;
+};
+
+struct decodeState {
+    std::vector<decodeFrame> stack;
+    bool started = false;
+};
+
+// Decoding one item into the receiver. Containers are kept on an explicit stack (see decodeCBOR).
+// root is 'o' or 'a' if the item has to be a map/array started with beginRoot(), 0 for any item.
+// Value that isn't complete is left unread, the decoding continues from it with the same state
+template<typename Receiver> static decodeStatus decodeItem(msgpackReader& reader, Receiver& receiver, char root, decodeState& state) {
+    std::vector<decodeFrame>& stack = state.stack;
+    while(true) {
+        while(!stack.empty() && stack.back().remaining == 0) {
+            bool map = stack.back().map;
+            stack.pop_back();
+            if(!(map ? receiver.endObject() : receiver.endArray())) return DECODE_STOPPED;
+        }
+        if(state.started && stack.empty()) return DECODE_DONE;
+        if(reader.at == reader.end) return DECODE_INCOMPLETE;
+
+        const uint8_t* valueStart = reader.at;
+        decodeFrame saved = stack.empty() ? decodeFrame{} : stack.back();
+        bool wasStarted = state.started;
+        auto incomplete = [&]() {
+            reader.at = valueStart;
+            if(!stack.empty()) stack.back() = saved;
+            state.started = wasStarted;
+            return DECODE_INCOMPLETE;
+        };
+
+        uint8_t marker = *reader.at++;
+        std::string_view text;
+        if(!stack.empty() && stack.back().map && stack.back().needKey) {
+            // Only str keys can be represented in the object
+            decodeStatus status = readString(reader, marker, text);
+            if(status == DECODE_INCOMPLETE) return incomplete();
+            if(status != DECODE_DONE) return status;
+            stack.back().needKey = false;
+            if(!receiver.onKey(text)) return DECODE_STOPPED;
+            continue;
+        }
+
+        // Size of the map/array or 0 if the item is not a container
+        bool isMap = (marker >= 0x80 && marker <= 0x8f) || marker == 0xde || marker == 0xdf;
+        bool isArray = (marker >= 0x90 && marker <= 0x9f) || marker == 0xdc || marker == 0xdd;
+        if(!state.started && root != 0 && !(root == 'o' ? isMap : isArray)) return DECODE_INVALID;
+        if(!stack.empty()) {
+            stack.back().remaining--;
+            if(stack.back().map) stack.back().needKey = true;
+        }
+        bool isRoot = !wasStarted && root != 0;
+        state.started = true;
+
+        bool ok;
+        uint64_t bits;
+        if(marker <= 0x7f) {
+            ok = receiver.onInteger(marker);
+        } else if(marker >= 0xe0) {
+            ok = receiver.onInteger((long long)int8_t(marker));
+        } else if(isMap || isArray) {
+            uint64_t size;
+            if(marker <= 0x9f) size = marker & 0x0f;
+            else if(!reader.read(size, (marker & 1) ? 4 : 2)) return incomplete();
+            if(isRoot) ok = receiver.beginRoot(size);
+            else if(isMap) ok = receiver.beginObject(size);
+            else ok = receiver.beginArray(size);
+            stack.push_back({size, isMap, true});
+        } else if((marker >= 0xa0 && marker <= 0xbf) || (marker >= 0xd9 && marker <= 0xdb)) {
+            decodeStatus status = readString(reader, marker, text);
+            if(status == DECODE_INCOMPLETE) return incomplete();
+            if(status != DECODE_DONE) return status;
+            ok = receiver.onString(text);
+        } else {
+            switch(marker) {
+                case 0xc0:
+                    ok = receiver.onNull();
+                    break;
+                case 0xc2:
+                case 0xc3:
+                    ok = receiver.onBool(marker == 0xc3);
+                    break;
+                case 0xca: {
+                    if(!reader.read(bits, 4)) return incomplete();
+                    uint32_t word = uint32_t(bits);
+                    float single;
+                    std::memcpy(&single, &word, sizeof(single));
+                    ok = receiver.onDouble(single);
+                    break;
+                }
+                case 0xcb: {
+                    if(!reader.read(bits, 8)) return incomplete();
+                    double value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    ok = receiver.onDouble(value);
+                    break;
+                }
+                // uint 8/16/32/64
+                case 0xcc:
+                case 0xcd:
+                case 0xce:
+                case 0xcf:
+                    if(!reader.read(bits, 1 << (marker - 0xcc))) return incomplete();
+                    if(bits > uint64_t(INT64_MAX)) return DECODE_INVALID;
+                    ok = receiver.onInteger((long long)bits);
+                    break;
+                // int 8/16/32/64, sign-extended from the size that was read
+                case 0xd0:
+                case 0xd1:
+                case 0xd2:
+                case 0xd3: {
+                    int size = 1 << (marker - 0xd0);
+                    if(!reader.read(bits, size)) return incomplete();
+                    int shift = 64 - size * 8;
+                    ok = receiver.onInteger((long long)(bits << shift) >> shift);
+                    break;
+                }
+                // bin, ext and the never used 0xc1 have no place in the object
+                default:
+                    return DECODE_INVALID;
+            }
+        }
+        if(!ok) return DECODE_STOPPED;
+    }
+}
+
+template<typename Receiver> static decodeStatus decodeItem(msgpackReader& reader, Receiver& receiver, char root) {
+    decodeState state;
+    return decodeItem(reader, receiver, root, state);
+}
+
+static bool decodeWhole(const uint8_t* data, size_t size, domReceiver& receiver, char root) {
+    msgpackReader reader{data, data + size};
+    return decodeItem(reader, receiver, root) == DECODE_DONE && reader.at == reader.end;
+}
+
+// Moving the single decoded value out of the holder array
+static void takeValue(json::array& holder, json::value& value) {
+    value = std::move(holder.data[0]);
+    if(auto object = std::get_if<std::unique_ptr<json::object>>(&value.value)) (*object)->parentArray = nullptr;
+    if(auto array = std::get_if<std::unique_ptr<json::array>>(&value.value)) (*array)->parentArray = nullptr;
+}
+
+bool json::decodeMsgPack(const uint8_t* data, size_t size, json::object& object) {
+    domReceiver receiver(object);
+    return decodeWhole(data, size, receiver, 'o');
+}
+
+bool json::decodeMsgPack(const uint8_t* data, size_t size, json::array& array) {
+    domReceiver receiver(array);
+    return decodeWhole(data, size, receiver, 'a');
+}
+
+bool json::decodeMsgPack(const uint8_t* data, size_t size, json::value& value) {
+    json::array holder;
+    domReceiver receiver(holder);
+    if(!decodeWhole(data, size, receiver, 0)) return false;
+    takeValue(holder, value);
+    return true;
+}
+
+bool json::decodeMsgPack(const uint8_t* data, size_t size, json::msgpackHandler& handler) {
+    msgpackReader reader{data, data + size};
+    handlerReceiver receiver{handler};
+    return decodeItem(reader, receiver, 0) == DECODE_DONE && reader.at == reader.end;
+}
+
+// --- Streaming decoder ---
+
+// Record being decoded, continued by every next() until it is complete
+struct json::msgpackStream::state {
+    decodeState decoder;
+    // Value built by next(value)
+    json::array holder;
+    std::optional<domReceiver> dom;
+    // next() that started the record, 'v' for the value and 'h' for the handler, 0 before the record
+    char mode = 0;
+    // Handler stopped or the record doesn't fit into the value, the rest of it is only checked
+    bool skipping = false;
+
+    void reset() {
+        decoder = decodeState{};
+        dom.reset();
+        holder.data.clear();
+        mode = 0;
+        skipping = false;
+    }
+};
+
+json::msgpackStream::msgpackStream() : impl(std::make_unique<state>()) {}
+
+json::msgpackStream::~msgpackStream() = default;
+
+void json::msgpackStream::feed(const uint8_t* data, size_t size) {
+    // Dropping the records that were read before growing the buffer
+    if(start > 0 && start >= buffer.size() / 2) {
+        buffer.erase(buffer.begin(), buffer.begin() + start);
+        scanned -= start;
+        start = 0;
+    }
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+size_t json::msgpackStream::buffered() const {
+    return buffer.size() - start;
+}
+
+// Decoding the fed data from where the last call stopped. Returns the same as next()
+int json::msgpackStream::advance(char mode, json::msgpackHandler* handler) {
+    if(failed) return -1;
+    state& s = *impl;
+    if(s.mode != mode) {
+        // Record was started by the other next()
+        s.reset();
+        s.mode = mode;
+        scanned = start;
+        if(mode == 'v') s.dom.emplace(s.holder);
+    }
+    msgpackReader reader{buffer.data() + scanned, buffer.data() + buffer.size()};
+    decodeStatus status = DECODE_STOPPED;
+    if(!s.skipping && mode == 'v') status = decodeItem(reader, *s.dom, 0, s.decoder);
+    else if(!s.skipping) {
+        handlerReceiver receiver{*handler};
+        status = decodeItem(reader, receiver, 0, s.decoder);
+    }
+    // Record is skipped as a whole even if it is stopped early
+    if(status == DECODE_STOPPED) {
+        s.skipping = true;
+        skipReceiver receiver;
+        status = decodeItem(reader, receiver, 0, s.decoder);
+    }
+    scanned = reader.at - buffer.data();
+    if(status == DECODE_INCOMPLETE) return 0;
+    if(status != DECODE_DONE) {
+        failed = true;
+        return -1;
+    }
+    start = scanned;
+    return 1;
+}
+
+int json::msgpackStream::next(json::value& value) {
+    int result = advance('v', nullptr);
+    if(result != 1) return result;
+    state& s = *impl;
+    if(!s.skipping) takeValue(s.holder, value);
+    else result = -1;
+    s.reset();
+    return result;
+}
+
+int json::msgpackStream::next(json::msgpackHandler& handler) {
+    int result = advance('h', &handler);
+    if(result == 1) impl->reset();
+    return result;
+}
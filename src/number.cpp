@@ -0,0 +1,102 @@
+#include <cstdlib>
+#include "parkinson.hpp"
+
+// --- Numbers kept as the text (see parseConfig::lazyNumbers) ---
+// Conversion is the same as of the parser, so lazy numbers read exactly as the converted ones
+
+struct json::rawNumber::state {
+    enum conversion : uint8_t { NOT_CONVERTED, CONVERTING, CONVERTED };
+    std::string text;
+    bool whole;
+    // Result is read only after CONVERTED is seen, readers that find CONVERTING convert the text themselves 
+    std::atomic<uint8_t> converted = NOT_CONVERTED;
+    // Result of the conversion, integer for the whole numbers and real for the rest
+    union {
+        long long integer;
+        double real;
+    } value = {0};
+
+    state(std::string text, bool whole) : text(std::move(text)), whole(whole) {}
+    // Result of the other number is kept only if it is stored completely
+    state(const state& other) : text(other.text), whole(other.whole) {
+        if(other.converted.load(std::memory_order_acquire) != CONVERTED) return;
+        value = other.value;
+        converted.store(CONVERTED, std::memory_order_relaxed);
+    }
+
+    // Taking the slot for the result, false if another read took it
+    bool claim() {
+        uint8_t expected = NOT_CONVERTED;
+        return converted.compare_exchange_strong(expected, CONVERTING, std::memory_order_relaxed);
+    }
+};
+
+json::rawNumber::rawNumber(std::string text, bool whole) : data(std::make_unique<state>(std::move(text), whole)) {}
+
+json::rawNumber::rawNumber(const rawNumber& other) : data(std::make_unique<state>(*other.data)) {}
+
+json::rawNumber::rawNumber(rawNumber&& other) noexcept = default;
+
+json::rawNumber& json::rawNumber::operator=(const rawNumber& other) {
+    if(this != &other) data = std::make_unique<state>(*other.data);
+    return *this;
+}
+
+json::rawNumber& json::rawNumber::operator=(rawNumber&& other) noexcept = default;
+
+json::rawNumber::~rawNumber() = default;
+
+const std::string& json::rawNumber::text() const {
+    return data->text;
+}
+
+bool json::rawNumber::whole() const {
+    return data->whole;
+}
+
+// Result is kept only by the reads of the number's own kind
+long long json::rawNumber::integer() const {
+    state& s = *data;
+    if(s.whole && s.converted.load(std::memory_order_acquire) == state::CONVERTED) return s.value.integer;
+    long long result = std::strtoll(s.text.c_str(), nullptr, 10);
+    if(s.whole && s.claim()) {
+        s.value.integer = result;
+        s.converted.store(state::CONVERTED, std::memory_order_release);
+    }
+    return result;
+}
+
+double json::rawNumber::real() const {
+    state& s = *data;
+    if(!s.whole && s.converted.load(std::memory_order_acquire) == state::CONVERTED) return s.value.real;
+    double result = std::strtod(s.text.c_str(), nullptr);
+    if(!s.whole && s.claim()) {
+        s.value.real = result;
+        s.converted.store(state::CONVERTED, std::memory_order_release);
+    }
+    return result;
+}
+
+bool json::value::getNumber(long long& out) const {
+    if(auto i = std::get_if<long long>(&value)) {
+        out = *i;
+        return true;
+    }
+    if(auto raw = std::get_if<rawNumber>(&value); raw != nullptr && raw->whole()) {
+        out = raw->integer();
+        return true;
+    }
+    return false;
+}
+
+bool json::value::getNumber(double& out) const {
+    if(auto d = std::get_if<double>(&value)) {
+        out = *d;
+        return true;
+    }
+    if(auto raw = std::get_if<rawNumber>(&value); raw != nullptr && !raw->whole()) {
+        out = raw->real();
+        return true;
+    }
+    return false;
+}
@@ -5,6 +5,49 @@
 
 #ifdef OBJECT_CPP
 #include "parkinson.hpp"
+
+// See share.cpp
+json::object* ownObject(json::value& slot, json::object* parentObject, json::array* parentArray, const std::string& key, size_t index);
+json::array* ownArray(json::value& slot, json::object* parentObject, json::array* parentArray, const std::string& key, size_t index);
+void unshare(json::object& object);
+void unshare(json::array& array);
+// Pointing the children to the object after it was moved 
+static void adoptChildren(json::object& object) {
+    for(auto& [key, val]: object.data) {
+        if(auto child = std::get_if<std::unique_ptr<json::object>>(&val.value)) (*child)->parent = &object;
+        else if(auto child = std::get_if<std::unique_ptr<json::array>>(&val.value)) (*child)->parentObject = &object;
+    }
+    if(!object.share) return;
+    // Copies of the shared children handed out by get (see share.cpp)
+    auto adopt = [&object](json::shareState::borrowedChild& child) {
+        if(child.objectCopy) child.objectCopy->parent = &object;
+        else if(child.arrayCopy) child.arrayCopy->parentObject = &object;
+    };
+    for(auto& [origin, child]: object.share->borrowed) adopt(child);
+    for(auto& child: object.share->orphans) adopt(child);
+}
+
+json::object::object(json::object&& other) noexcept
+    : data(std::move(other.data)), parent(other.parent), parentArray(other.parentArray), 
+      cacheOutput(other.cacheOutput), outputCache(std::move(other.outputCache)), 
+      outputCacheIndent(other.outputCacheIndent), outputDirty(other.outputDirty), share(std::move(other.share)) {
+    adoptChildren(*this);
+}
+
+json::object& json::object::operator=(json::object&& other) noexcept {
+    if(this == &other) return *this;
+    data = std::move(other.data);
+    parent = other.parent;
+    parentArray = other.parentArray;
+    cacheOutput = other.cacheOutput;
+    outputCache = std::move(other.outputCache);
+    outputCacheIndent = other.outputCacheIndent;
+    outputDirty = other.outputDirty;
+    share = std::move(other.share);
+    adoptChildren(*this);
+    return *this;
+}
+
 // JSON OBJECT get functions
 
 bool json::object::contains(const std::string key) {
@@ -32,21 +75,13 @@ bool json::object::get(const std::string key, long long &out) {
     auto it = data.find(key);
     if(it == data.end()) return false;
     if(it->second.type != JSON_NUMBER) return false;
-    if(long long* x = std::get_if<long long>(&it->second.value)) {
-        out = *x;
-        return true;
-    }
-    return false;
+    return it->second.getNumber(out);
 } 
 bool json::object::get(const std::string key, double& out) {
     auto it = data.find(key);
     if(it == data.end()) return false;
     if(it->second.type != JSON_NUMBER) return false;
-    if(double* x = std::get_if<double>(&it->second.value)) {
-        out = *x;
-        return true;
-    }
-    return false;   
+    return it->second.getNumber(out);
 } 
 bool json::object::get(const std::string key, bool &out) {
    auto it = data.find(key);
@@ -65,7 +100,7 @@ bool json::object::get(const std::string key, json::object *&out) {
     auto it = data.find(key);
     if(it == data.end()) return false;
     if(it->second.type != JSON_OBJECT) return false;
-    out = std::get<std::unique_ptr<json::object>>(it->second.value).get();
+    out = ownObject(it->second, this, nullptr, it->first, 0);
     return true;
 }
 
@@ -73,36 +108,59 @@ bool json::object::get(const std::string key, json::array *&out) {
     auto it = data.find(key);
     if(it == data.end()) return false;
     if(it->second.type != JSON_ARRAY) return false;
-    out = std::get<std::unique_ptr<json::array>>(it->second.value).get();
+    out = ownArray(it->second, this, nullptr, it->first, 0);
+    return true;
+}
+
+bool json::object::get(const std::string key, const json::object *&out) const {
+    auto it = data.find(key);
+    if(it == data.end()) return false;
+    if(it->second.type != JSON_OBJECT) return false;
+    out = it->second.getObject();
+    return true;
+}
+
+bool json::object::get(const std::string key, const json::array *&out) const {
+    auto it = data.find(key);
+    if(it == data.end()) return false;
+    if(it->second.type != JSON_ARRAY) return false;
+    out = it->second.getArray();
     return true;
 }
 
 void json::object::setValue(const std::string key, const char* value) {
+    invalidate();
     data[key] = json::value{ std::string(value), JSON_STRING };
 }
 
 void json::object::setValue(const std::string key, std::string value) {
+    invalidate();
     data[key] = json::value{ std::string(value), JSON_STRING };
 }
 
 void json::object::setValue(const std::string key, long long value) {
+    invalidate();
     data[key] = json::value{ value, JSON_NUMBER };
 }
 
 void json::object::setValue(const std::string key, double value) {
+    invalidate();
     data[key] = json::value{ value, JSON_NUMBER };
 }
 
 void json::object::setValue(const std::string key, bool value) {
+    invalidate();
     data[key] = json::value{ value, JSON_BOOL };
 }
 
 void json::object::setValue(const std::string key, std::unique_ptr<json::object> value) {
+    invalidate();
     value->addParentObject(this);
     data[key] = json::value{ std::move(value), JSON_OBJECT };
 }
 
 void json::object::setValue(const std::string key, std::unique_ptr<json::array> value) {
+    invalidate();
     value->addParentObject(this);
     data[key] = json::value{ std::move(value), JSON_ARRAY };
 }
@@ -124,54 +182,76 @@ json::array& json::object::emplaceArray(const std::string key) {
 }
 
 void json::object::setNull(const std::string key) {
+    invalidate();
     data[key] = json::value{ std::monostate{}, JSON_NULL }; 
 }
 
-std::unique_ptr<json::object> json::object::copy(json::object &original) {
+// Copying a value that is not an object or an array
+json::value copyScalar(const json::value& val) {
+    switch(val.type) {
+        case json::JSON_STRING:
+            return json::value{ std::get<std::string>(val.value), json::JSON_STRING };
+        case json::JSON_NUMBER:
+            if(const long long* t = std::get_if<long long>(&val.value)) return json::value{ *t, json::JSON_NUMBER };
+            if(const json::rawNumber* raw = std::get_if<json::rawNumber>(&val.value)) return json::value{ *raw, json::JSON_NUMBER };
+            return json::value{ std::get<double>(val.value), json::JSON_NUMBER };
+        case json::JSON_BOOL:
+            return json::value{ std::get<bool>(val.value), json::JSON_BOOL };
+        default:
+            return json::value{ std::monostate{}, json::JSON_NULL };
+    }
+}
+
+std::unique_ptr<json::object> json::object::copy(const json::object &original) {
     std::unique_ptr<json::object> object = std::make_unique<json::object>();
+    object->cacheOutput = original.cacheOutput;
+    // Buckets are allocated once instead of growing while copying
+    object->data.reserve(original.data.size());
     for(auto& [key, val]: original.data) {
-        json::value copyVal;
-        copyVal.type = val.type;
-
         switch(val.type) {
-            case JSON_STRING: {
-                copyVal.value = std::get<std::string>(val.value);
-                break;  
-            }
-            case JSON_NUMBER: {
-                long long *t;
-                if((t = std::get_if<long long>(&val.value))) copyVal.value = *t;
-                else copyVal.value = std::get<double>(val.value);
-                break;  
-            }
-            case JSON_BOOL: {
-                copyVal.value = std::get<bool>(val.value);
-                break;  
-            }
-            case JSON_NULL: { 
-                copyVal.value = std::monostate{};
-                break;  
-            }
             case JSON_OBJECT: {
-                auto &origObj = *std::get<std::unique_ptr<json::object>>(val.value);
-                auto copyObj = json::object::copy(origObj);
+                // Shared children are never changed, so the copy can share them too 
+                if(auto shared = std::get_if<std::shared_ptr<const json::object>>(&val.value)) {
+                    object->data.emplace(key, json::value{ *shared, JSON_OBJECT });
+                    break;
+                }
+                auto copyObj = json::object::copy(*std::get<std::unique_ptr<json::object>>(val.value));
                 copyObj->addParentObject(object.get());
-                copyVal.value = std::move(copyObj);
+                object->data.emplace(key, json::value{ std::move(copyObj), JSON_OBJECT });
                 break;
             }
             case JSON_ARRAY: {
-                auto &origArr = *std::get<std::unique_ptr<json::array>>(val.value);
-                auto copyArr = json::array::copy(origArr);
+                if(auto shared = std::get_if<std::shared_ptr<const json::array>>(&val.value)) {
+                    object->data.emplace(key, json::value{ *shared, JSON_ARRAY });
+                    break;
+                }
+                auto copyArr = json::array::copy(*std::get<std::unique_ptr<json::array>>(val.value));
                 copyArr->addParentObject(object.get());
-                copyVal.value = std::move(copyArr); 
+                object->data.emplace(key, json::value{ std::move(copyArr), JSON_ARRAY });
                 break;
             }
-        } 
-        object->data.emplace(key, std::move(copyVal));
+            default:
+                object->data.emplace(key, copyScalar(val));
+        }
     }
     return object;
 }
 
+size_t json::object::countNodes(size_t limit) const {
+    size_t count = 1;
+    for(auto& [key, val]: data) {
+        if(count >= limit) break;
+        if(val.type == JSON_OBJECT) {
+            count += val.getObject()->countNodes(limit - count);
+        } else if(val.type == JSON_ARRAY) {
+            count += val.getArray()->countNodes(limit - count);
+        } else {
+            count++;
+        }
+    }
+    return count;
+}
+
 json::object* json::object::goToParentObject() {
     return parent;
 }
@@ -181,8 +261,51 @@ json::array* json::object::goToParentArray() {
 }
 
 bool json::object::remove(const std::string key) {
-    if(data.erase(key) > 0) return true;
+    if(data.erase(key) > 0) {
+        invalidate();
+        return true;
+    }
     return false;
 }
 
+void json::object::setOutputCache(bool enable, bool recursive) {
+    cacheOutput = enable;
+    outputCacheIndent = -1;
+    if(!enable) std::string().swap(outputCache);
+    if(!recursive) return;
+    // Shared children are never written to, their output is not cached 
+    for(auto& [key, val]: data) {
+        if(auto obj = std::get_if<std::unique_ptr<json::object>>(&val.value)) {
+            (*obj)->setOutputCache(enable, recursive);
+        } else if(auto arr = std::get_if<std::unique_ptr<json::array>>(&val.value)) {
+            (*arr)->setOutputCache(enable, recursive);
+        }
+    }
+}
+
+void json::object::invalidate() {
+    // Walking up to the root, every structure on the way contains the changed one.
+    // Structures above the first dirty one are dirty already, unless it has a snapshot or is a copy
+    // of a shared child (see share.cpp). Those are settled on the way as well
+    json::object* obj = this;
+    json::array* arr = nullptr;
+    while(obj != nullptr || arr != nullptr) {
+        if(obj != nullptr) {
+            if(obj->outputDirty && !(obj->share && obj->share->active())) return;
+            obj->outputDirty = true;
+            obj->outputCacheIndent = -1;
+            if(obj->share) unshare(*obj);
+            arr = obj->parentArray;
+            obj = obj->parent;
+        } else {
+            if(arr->outputDirty && !(arr->share && arr->share->active())) return;
+            arr->outputDirty = true;
+            arr->outputCacheIndent = -1;
+            if(arr->share) unshare(*arr);
+            obj = arr->parentObject;
+            arr = arr->parentArray;
+        }
+    }
+}
+
 #endif
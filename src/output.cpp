@@ -1,12 +1,19 @@
 #include "parkinson.hpp"
 #include <iomanip>
+#include <sstream>
 void outputValue(std::ostream &stream, const json::value& value, int indent = 0);
 
 void outputIndent(std::ostream &stream, int indentationLvl) {
     for(int i = 0; i < indentationLvl; i++) stream << "    ";
 }
 
-void json::outputObject(std::ostream &stream, const json::object& object, int indent) {
+// Set while the text of a cached structure is rendered on this thread. Structures written into the cache are clean
+// until they change (see object::invalidate), output without the caches only reads the structures 
+static thread_local int renderingCache = 0;
+
+void writeObject(std::ostream &stream, const json::object& object, int indent) {
+    // Shared structures are never dirty, so they are only read here 
+    if(renderingCache > 0 && object.outputDirty) object.outputDirty = false;
     stream << "{\n";
     for(auto it = object.data.begin(); it != object.data.end(); ++it) {
         outputIndent(stream, indent + 1);
@@ -19,7 +26,8 @@ void json::outputObject(std::ostream &stream, const json::object& object, int in
     indent != 0 ? stream << "}" : stream << "}\n";
 }
 
-void outputArray(std::ostream &stream, const json::array& array, int indent = 0) {
+void writeArray(std::ostream &stream, const json::array& array, int indent) {
+    if(renderingCache > 0 && array.outputDirty) array.outputDirty = false;
     stream << "[\n";
     for(size_t i = 0; i < array.data.size(); i++) {
        outputIndent(stream, indent+1);
@@ -31,6 +39,31 @@ void outputArray(std::ostream &stream, const json::array& array, int indent = 0)
     stream << "]";
 }
 
+// Writing cached text of the structure, text is rendered again if it was dropped
+// or written with a different indentation 
+template<typename T> void writeCached(std::ostream &stream, const T& structure, int indent, 
+                                      void (*write)(std::ostream&, const T&, int)) {
+    if(structure.outputCacheIndent != indent) {
+        std::ostringstream text;
+        renderingCache++;
+        write(text, structure, indent);
+        renderingCache--;
+        structure.outputCache = text.str();
+        structure.outputCacheIndent = indent;
+    }
+    stream.write(structure.outputCache.data(), structure.outputCache.size());
+}
+
+void json::outputObject(std::ostream &stream, const json::object& object, int indent) {
+    if(object.cacheOutput) writeCached(stream, object, indent, writeObject);
+    else writeObject(stream, object, indent);
+}
+
+void outputArray(std::ostream &stream, const json::array& array, int indent = 0) {
+    if(array.cacheOutput) writeCached(stream, array, indent, writeArray);
+    else writeArray(stream, array, indent);
+}
+
 void outputValue(std::ostream &stream, const json::value& value, int indent) {
     switch(value.type) {
         case json::JSON_STRING:
@@ -43,6 +76,9 @@ void outputValue(std::ostream &stream, const json::value& value, int indent) {
         case json::JSON_NUMBER:
             if(const long long* pInt = std::get_if<long long>(&value.value)) {
                 stream << *pInt;
+            } else if(const json::rawNumber* raw = std::get_if<json::rawNumber>(&value.value)) {
+                // Lazy number is written as it was in the text
+                stream << raw->text();
             } else {
                 stream << std::setprecision(17) << std::get<double>(value.value);
                 //stream << std::get<double>(value.value);
@@ -52,10 +88,154 @@ void outputValue(std::ostream &stream, const json::value& value, int indent) {
             stream << "null"; 
             break;  
         case json::JSON_OBJECT:
-            outputObject(stream, *std::get<std::unique_ptr<json::object>>(value.value), indent); 
+            outputObject(stream, *value.getObject(), indent); 
             break;  
         case json::JSON_ARRAY:
-            outputArray(stream, *std::get<std::unique_ptr<json::array>>(value.value), indent); 
+            outputArray(stream, *value.getArray(), indent); 
             break;  
     }
 }
+
+// --- Parallel output ---
+
+// Line of the output: key (nullptr for array elements), value and separator after it
+struct outputEntry {
+    const std::string* key;
+    const json::value* value;
+    bool comma;
+};
+
+// Part of the parallel output. Either text that is written as it is 
+// or a run of entries that is rendered into text by one of the pool tasks 
+struct outputChunk {
+    std::string text;
+    std::vector<outputEntry> entries;
+    size_t nodes = 0;
+    int indent = 0;
+};
+
+struct outputPlan {
+    std::vector<outputChunk> chunks;
+    size_t chunkNodes;
+
+    void literal(const std::string& text) {
+        if(chunks.empty() || !chunks.back().entries.empty()) chunks.emplace_back();
+        chunks.back().text += text;
+    }
+    void entry(const outputEntry& entry, size_t nodes, int indent) {
+        if(chunks.empty() || chunks.back().entries.empty() || 
+           chunks.back().indent != indent || chunks.back().nodes >= chunkNodes) {
+            chunks.emplace_back();
+            chunks.back().indent = indent;
+        }
+        chunks.back().entries.push_back(entry);
+        chunks.back().nodes += nodes;
+    }
+};
+
+size_t countValueNodes(const json::value& value, size_t limit) {
+    switch(value.type) {
+        case json::JSON_OBJECT:
+            return value.getObject()->countNodes(limit);
+        case json::JSON_ARRAY:
+            return value.getArray()->countNodes(limit);
+        default:
+            return 1;
+    }
+}
+
+std::string indentString(int indentationLvl) {
+    return std::string(indentationLvl * 4, ' ');
+}
+
+void planValue(outputPlan& plan, const json::value& value, int indent);
+
+void planObject(outputPlan& plan, const json::object& object, int indent) {
+    if(object.cacheOutput && object.outputCacheIndent == indent) {
+        plan.literal(object.outputCache);
+        return;
+    }
+    plan.literal("{\n");
+    for(auto it = object.data.begin(); it != object.data.end(); ++it) {
+        bool comma = std::next(it) != object.data.end();
+        size_t nodes = countValueNodes(it->second, plan.chunkNodes + 1);
+        if(nodes > plan.chunkNodes) {
+            // Subtree is too big for one task, splitting its members between several
+            plan.literal(indentString(indent + 1) + "\"" + it->first + "\": ");
+            planValue(plan, it->second, indent + 1);
+            plan.literal(comma ? ",\n" : "\n");
+        } else {
+            plan.entry(outputEntry{ &it->first, &it->second, comma }, nodes, indent + 1);
+        }
+    }
+    plan.literal(indentString(indent) + (indent != 0 ? "}" : "}\n"));
+}
+
+void planArray(outputPlan& plan, const json::array& array, int indent) {
+    if(array.cacheOutput && array.outputCacheIndent == indent) {
+        plan.literal(array.outputCache);
+        return;
+    }
+    plan.literal("[\n");
+    for(size_t i = 0; i < array.data.size(); i++) {
+        bool comma = i + 1 != array.data.size();
+        size_t nodes = countValueNodes(array.data[i], plan.chunkNodes + 1);
+        if(nodes > plan.chunkNodes) {
+            plan.literal(indentString(indent + 1));
+            planValue(plan, array.data[i], indent + 1);
+            plan.literal(comma ? ",\n" : "\n");
+        } else {
+            plan.entry(outputEntry{ nullptr, &array.data[i], comma }, nodes, indent + 1);
+        }
+    }
+    plan.literal(indentString(indent) + "]");
+}
+
+void planValue(outputPlan& plan, const json::value& value, int indent) {
+    if(value.type == json::JSON_OBJECT) {
+        planObject(plan, *value.getObject(), indent);
+    } else {
+        planArray(plan, *value.getArray(), indent);
+    }
+}
+
+void renderChunk(outputChunk& chunk) {
+    std::ostringstream stream;
+    for(auto& entry: chunk.entries) {
+        outputIndent(stream, chunk.indent);
+        if(entry.key != nullptr) stream << "\"" << *entry.key << "\": ";
+        outputValue(stream, *entry.value, chunk.indent);
+        if(entry.comma) stream << ",";
+        stream << "\n";
+    }
+    chunk.text = stream.str();
+    chunk.entries.clear();
+}
+
+void json::outputObject(std::ostream &stream, const json::object& object, const json::outputConfig& config) {
+    json::threadPool& pool = config.pool != nullptr ? *config.pool : json::threadPool::shared();
+    if(pool.size() < 2 || object.countNodes(config.parallelThreshold) < config.parallelThreshold) {
+        json::outputObject(stream, object);
+        return;
+    }
+    outputPlan plan;
+    plan.chunkNodes = config.chunkNodes > 0 ? config.chunkNodes : 1;
+    planObject(plan, object, 0);
+
+    // Rendering chunks in waves, so only a few rendered chunks are kept in memory at a time 
+    const size_t wave = pool.size() * 4;
+    std::vector<size_t> tasks;
+    size_t written = 0;
+    for(size_t i = 0; i < plan.chunks.size(); i++) {
+        if(!plan.chunks[i].entries.empty()) tasks.push_back(i);
+        if(tasks.size() < wave && i + 1 != plan.chunks.size()) continue;
+        pool.run(tasks.size(), [&](size_t t) {
+            renderChunk(plan.chunks[tasks[t]]);
+        });
+        for(; written <= i; written++) {
+            stream.write(plan.chunks[written].text.data(), plan.chunks[written].text.size());
+            std::string().swap(plan.chunks[written].text);
+        }
+        tasks.clear();
+    }
+}
@@ -1,10 +1,24 @@
+#ifndef PARKINSON_HPP
+#define PARKINSON_HPP
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <span>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <variant>
+#include <thread>
 #include <vector>
 #include <istream>
 
@@ -20,6 +34,14 @@ enum types {
     JSON_NULL
 };
 
+// How object::copy/array::copy copy the children 
+enum copyMode {
+    // Every child is copied 
+    COPY_DEEP,
+    // Children are shared with the original and copied only when they are changed 
+    COPY_SHARED
+};
+
 // Return codes of the parser depending on the error
 enum parseRetVal {
     PARSE_SUCCESS,
@@ -39,7 +61,11 @@ enum parseRetVal {
     PARSE_UNHANDLED_ERROR,
     PARSE_ERR_NULLPTR_PARENT,
     PARSE_ERR_NUMBER_OVERFLOW_OR_UNDERFLOW,
-    PARSER_ERR_COMMA_AFTER_LAST_ELEMENT
+    PARSER_ERR_COMMA_AFTER_LAST_ELEMENT,
+    // File couldn't be read (see ingestFiles)
+    PARSE_ERR_IO,
+    // Text is not well-formed UTF-8 (see validate)
+    PARSE_ERR_INVALID_UTF8
 };
 
 // See definition below
@@ -51,21 +77,55 @@ struct object;
 // See definition below 
 struct array;
 
+// See definition below 
+struct threadPool;
+
+// See definition below
+struct shareState;
+
 // Structure that holds information about parse status
 struct exitCode {
     parseRetVal returnCode;
-    std::string message;
+    // Name of the return code. Points to the static text, so setting it costs nothing 
+    std::string_view message;
     int lineNumber = 0, characterNumber = 0;
+    // Bytes of the text read until the error was found
+    size_t offset = 0;
     void reset() {
-        message.clear();
+        message = {};
         lineNumber = 0;
         characterNumber = 0;
+        offset = 0;
     }
 };
 
+// Key of the member with its hash computed in advance (see path::segment)
+struct hashedKey {
+    std::string_view key;
+    size_t hash;
+    bool operator==(std::string_view other) const { return key == other; }
+};
+
+// Hash of the member keys. Transparent, so members can be found by std::string_view
+// and by hashedKey without hashing the key again
+struct keyHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    size_t operator()(const hashedKey& key) const { return key.hash; }
+};
+
+// Members of the object
+using members = std::unordered_map<std::string, value, keyHash, std::equal_to<>>;
+
 // Json object structure and its functions
 struct object {
-    std::unordered_map<std::string, value> data;
+    object() = default;
+    // Moving the object. Children are pointed to the new place, so moved objects can be stored anywhere
+    object(object&& other) noexcept;
+    object& operator=(object&& other) noexcept;
+    // Children are destroyed without recursion, so deeply nested objects can't overflow the stack
+    ~object();
+    members data;
     // Parents and children declaration
     object* parent = nullptr;
     array* parentArray = nullptr;
@@ -76,9 +136,20 @@ struct object {
     void addParentArray(array* parentArray) {
         this->parentArray = parentArray;
     }
+    // Cached output of the object (see setOutputCache)
+    bool cacheOutput = false;
+    mutable std::string outputCache;
+    mutable int outputCacheIndent = -1;
+    // Set when the structure changed after it was written into a cache last time (see setOutputCache).
+    // If a structure is dirty, all its parents are dirty too, so invalidation stops at the first dirty one  
+    mutable bool outputDirty = true;
+    // Copy-on-write state (see COPY_SHARED), nullptr while the object was never shared
+    std::unique_ptr<shareState> share;
     // Clearing data and parents of the object
     void clear() {
+        invalidate();
         data.clear();
+        share.reset();
         parent = nullptr;
         parentArray = nullptr;
     } 
@@ -96,6 +167,9 @@ struct object {
     bool get(const std::string key, bool &out); // Getting boolean (JSON_BOOL)
     bool get(const std::string key, object *&out); // Getting an object (pointer to the object) (JSON_OBJECT)
     bool get(const std::string key, array *&out); // Getting an array (Pointer to the array) (JSON_ARRAY)
+    // Getting objects/arrays only for reading. Unlike functions above, shared children are returned as they are (see COPY_SHARED)
+    bool get(const std::string key, const object *&out) const;
+    bool get(const std::string key, const array *&out) const;
     // Overloaded function to change value of the existing key 
     // or to add a new element with given key if element doesn't exist  
     void setValue(const std::string key, const char* value); // Setting string (1st method)  
@@ -113,16 +187,41 @@ struct object {
     // If element was removed, true is returned, otherwise false is returned 
     bool remove(const std::string key); 
     // Copying object. Returns a NON-COPYABLE pointer 
-    static std::unique_ptr<object> copy(object &original);
+    static std::unique_ptr<object> copy(const object &original);
+    // Copying object with COPY_SHARED mode shares a frozen snapshot of the children of the original with the copy.
+    // Snapshot is made by the first shared copy and kept by the original until it changes, so the next copies
+    // cost only the top level of the object and the changed parts. The original itself stays as it is.
+    // Shared child got with get(key, object*&)/get(key, array*&) is copied one level deep for the caller,
+    // the copy replaces the shared child when it is changed, the other copies don't see the change 
+    static std::unique_ptr<object> copy(object &original, copyMode mode);
+    // Copying object using the thread pool. Subtrees are split into tasks of about chunkNodes nodes
+    // Small objects are copied on the calling thread 
+    static std::unique_ptr<object> copy(const object &original, threadPool& pool, size_t chunkNodes = 1 << 12);
+    // Counting the object itself and all the values below it.
+    // Counting stops as soon as limit is reached, so big subtrees can be checked cheaply 
+    size_t countNodes(size_t limit = SIZE_MAX) const;
     // Functions to jump to parent structures. 
     // Returns pointers to parent structure ot nullptr if parent doesn't exist. 
     // Only root object doesn't have any parents
     object* goToParentObject();
     array* goToParentArray();
+    // Keeping the text written by outputObject, so next output of unchanged object is a single copy.
+    // If recursive, cache is enabled/disabled for all objects and arrays inside as well 
+    // Cache is dropped when object or its children change through setValue/setNull/emplace/push/remove functions
+    // If data is changed directly, invalidate() has to be called on the changed structure 
+    void setOutputCache(bool enable, bool recursive = true);
+    // Dropping cached output of the object and all of its parents 
+    void invalidate();
 };
 
 // Array structure with it's functions 
 struct array {
+    array() = default;
+    // See object::object(object&&)
+    array(array&& other) noexcept;
+    array& operator=(array&& other) noexcept;
+    // See object::~object
+    ~array();
     // Data in the array
     // See value for more details on what it holds 
     std::vector<value> data;  
@@ -137,6 +236,13 @@ struct array {
     void addParentArray(array* parent) {
         this->parentArray = parent;
     }
+    // Cached output of the array (see object::setOutputCache)
+    bool cacheOutput = false;
+    mutable std::string outputCache;
+    mutable int outputCacheIndent = -1;
+    mutable bool outputDirty = true;
+    // Copy-on-write state (see object::share)
+    std::unique_ptr<shareState> share;
     // Public functions to manipulate data in the array 
     // Returns length of the array 
     int length();
@@ -153,6 +259,9 @@ struct array {
     bool get(size_t index, bool &out); // Get bool (JSON_BOOL)
     bool get(size_t index, object *&out); // Get an object (pointer to an object) 
     bool get(size_t index, array *&out); // Get an array (pointer to an array)
+    // Read-only getters (see object::get(key, const object*&))
+    bool get(size_t index, const object *&out) const;
+    bool get(size_t index, const array *&out) const;
     // Overloaded function to push data into the array  
     void push(std::string val); // Push the string (1st method) 
     void push(const char *val); // Push the string (2nd method)
@@ -178,7 +287,13 @@ struct array {
     // Other array-related functions 
     // Copying the array 
     // Returns a NON-COPYABLE pointer to the newly allocated copy 
-    static std::unique_ptr<array> copy(array& original); 
+    static std::unique_ptr<array> copy(const array& original); 
+    // Copying the array sharing its children (see object::copy)
+    static std::unique_ptr<array> copy(array& original, copyMode mode); 
+    // Copying the array using the thread pool (see object::copy)
+    static std::unique_ptr<array> copy(const array& original, threadPool& pool, size_t chunkNodes = 1 << 12);
+    // Counting the array itself and all the values below it (see object::countNodes)
+    size_t countNodes(size_t limit = SIZE_MAX) const;
     // Functions to jump to the parents of the current array
     // Array can have only one parent at a time
     // functions return pointer to the parent structure 
@@ -187,6 +302,32 @@ struct array {
     // Removing the element with at the index position
     // If such element doesn't exist, returns false
     bool remove(uint index);
+    // Output cache functions, same as object::setOutputCache and object::invalidate
+    void setOutputCache(bool enable, bool recursive = true);
+    void invalidate();
+};
+
+// Number kept as the text it was parsed from (see parseConfig::lazyNumbers).
+// Text is converted on the first read and the result is kept. Output writes the text as it is.
+// Numbers can be read from several threads at once, the result is kept by the first read that finishes.
+// Everything is kept behind one pointer, so lazy numbers don't make values bigger 
+struct rawNumber {
+    rawNumber(std::string text, bool whole);
+    rawNumber(const rawNumber& other);
+    rawNumber(rawNumber&& other) noexcept;
+    rawNumber& operator=(const rawNumber& other);
+    rawNumber& operator=(rawNumber&& other) noexcept;
+    ~rawNumber();
+    const std::string& text() const;
+    // No fraction and no exponent, read as long long. Otherwise read as double
+    bool whole() const;
+    long long integer() const;
+    double real() const;
+    // Numbers are equal when their texts are 
+    bool operator==(const rawNumber& other) const { return text() == other.text(); }
+private:
+    struct state;
+    std::unique_ptr<state> data;
 };
 
 // Internal structure that allows to have a polymorphyc type 
@@ -200,17 +341,622 @@ struct value {
         std::string,
         std::monostate,
         std::unique_ptr<object>,
-        std::unique_ptr<array>
+        std::unique_ptr<array>,
+        std::shared_ptr<const object>, // Shared objects and arrays (see COPY_SHARED) 
+        std::shared_ptr<const array>,
+        rawNumber // Number that is not converted yet
     > value;
     // Type corresponding to the value so it is clear 
     types type;
+    // Object/array held by the value, whether it is owned or shared
+    // nullptr if the value is not an object/array
+    const object* getObject() const;
+    const array* getArray() const;
+    // Number held by the value, whether it is converted or kept as the text (see rawNumber)
+    // false if the value is not an integer/a double 
+    bool getNumber(long long& out) const;
+    bool getNumber(double& out) const;
+};
+
+// Copy-on-write state of an object/array (see COPY_SHARED and share.cpp)
+struct shareState {
+    // Frozen copy given to the shared copies of the structure. Dropped when the structure changes
+    std::shared_ptr<const object> objectSnapshot;
+    std::shared_ptr<const array> arraySnapshot;
+    // Shared structure this one was copied from by get(key, object*&). Parent keeps holding 
+    // the shared one until this structure changes
+    std::shared_ptr<const object> objectOrigin;
+    std::shared_ptr<const array> arrayOrigin;
+    // Copies of the shared children handed out by get(key, object*&) and not changed yet 
+    struct borrowedChild {
+        std::string key;
+        size_t index = 0;
+        std::unique_ptr<object> objectCopy;
+        std::unique_ptr<array> arrayCopy;
+    };
+    std::unordered_map<const void*, borrowedChild> borrowed;
+    // Copies of the children that were replaced before the copies changed. Kept for the pointers handed out 
+    std::vector<borrowedChild> orphans;
+    // Changes of the structure have to go through share.cpp 
+    bool active() const {
+        return objectSnapshot || arraySnapshot || objectOrigin || arrayOrigin;
+    }
 };
 
 // --- END JSON DATA STRUCTURES --- 
 
+// Fixed set of worker threads used by the parallel functions of the library
+struct threadPool {
+    // Starting the workers. 0 threads means std::thread::hardware_concurrency()
+    explicit threadPool(unsigned threads = 0);
+    ~threadPool();
+    threadPool(const threadPool&) = delete;
+    threadPool& operator=(const threadPool&) = delete;
+    // Number of threads working on a job, including the calling thread 
+    unsigned size() const;
+    // Calling fn(i) for every i in [0, count) and waiting for all of them to finish.
+    // Tasks are taken one by one from a shared counter, so tasks of different sizes balance out.
+    // Calling thread works on the tasks as well. Must not be called from inside of a task 
+    void run(size_t count, const std::function<void(size_t)>& fn);
+    // Pool shared by the library when no pool is given explicitly
+    static threadPool& shared();
+private:
+    struct job {
+        const std::function<void(size_t)>* fn;
+        size_t count;
+        std::atomic<size_t> next;
+    };
+    void work(job& job);
+    std::vector<std::thread> workers;
+    std::mutex runLock;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    job* current = nullptr;
+    unsigned long generation = 0;
+    unsigned active = 0;
+    bool stop = false;
+};
+
+// Background thread destroying the structures handed to it, 
+// so freeing big documents doesn't take time of the calling thread 
+struct reclaimer {
+    reclaimer();
+    // Destroys everything that is still waiting and stops the thread 
+    ~reclaimer();
+    reclaimer(const reclaimer&) = delete;
+    reclaimer& operator=(const reclaimer&) = delete;
+    // Handing the structure to the thread. Root objects can be moved in directly
+    void retire(std::unique_ptr<object> object);
+    void retire(std::unique_ptr<array> array);
+    void retire(object&& object);
+    // Waiting until everything retired before the call is destroyed 
+    void flush();
+    // Reclaimer shared by the whole program
+    static reclaimer& shared();
+private:
+    void run();
+    std::vector<std::unique_ptr<object>> objects;
+    std::vector<std::unique_ptr<array>> arrays;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long retired = 0;
+    unsigned long destroyed = 0;
+    bool stop = false;
+    std::thread thread;
+};
+
+// 128-bit hash (see hashCanonical)
+struct hash128 {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    bool operator==(const hash128& other) const = default;
+};
+
+// Settings of the parallel output (see outputObject below)
+struct outputConfig {
+    // Pool rendering the subtrees. nullptr means threadPool::shared()
+    threadPool* pool = nullptr;
+    // Documents with fewer nodes than that are written on the calling thread
+    size_t parallelThreshold = 1 << 16;
+    // Approximate number of nodes rendered by one task
+    size_t chunkNodes = 1 << 12;
+};
+
+// --- FROZEN DOCUMENT ---
+// Read-only document stored as one tape of 64-bit words plus a buffer of strings (see frozen.cpp)
+// frozen_object and frozen_array are small views into the tape, 
+// they are valid as long as the document they came from is alive 
+struct frozen_array;
+
+struct frozen_object {
+    // Number of elements of the object
+    size_t size() const;
+    // Same as the functions of the object. Keys are searched linearly, 
+    // nested objects and arrays are skipped in one step
+    bool contains(std::string_view key) const;
+    bool getType(std::string_view key, types &out) const;
+    bool isNull(std::string_view key) const;
+    bool get(std::string_view key, std::string &out) const; // Getting the string (JSON_STRING)
+    bool get(std::string_view key, std::string_view &out) const; // Getting the string without copying it (JSON_STRING)
+    bool get(std::string_view key, long long &out) const; // Getting long long (JSON_NUMBER)
+    bool get(std::string_view key, double &out) const; // Getting double (JSON_NUMBER)
+    bool get(std::string_view key, bool &out) const; // Getting boolean (JSON_BOOL)
+    bool get(std::string_view key, frozen_object &out) const; // Getting an object (JSON_OBJECT)
+    bool get(std::string_view key, frozen_array &out) const; // Getting an array (JSON_ARRAY)
+    // Internal: tape of the document, its strings and the index of the '{' word 
+    const uint64_t* tape = nullptr;
+    const char* strings = nullptr;
+    size_t index = 0;
+private:
+    size_t find(std::string_view key) const;
+};
+
+struct frozen_array {
+    // Length of the array, O(1) 
+    size_t length() const;
+    // Same as the functions of the array. Reaching an element skips the ones before it
+    bool getType(size_t index, types &out) const;
+    bool isNull(size_t index) const;
+    bool get(size_t index, std::string &out) const;
+    bool get(size_t index, std::string_view &out) const;
+    bool get(size_t index, long long &out) const;
+    bool get(size_t index, double &out) const;
+    bool get(size_t index, bool &out) const;
+    bool get(size_t index, frozen_object &out) const;
+    bool get(size_t index, frozen_array &out) const;
+    // Internal: see frozen_object 
+    const uint64_t* tape = nullptr;
+    const char* strings = nullptr;
+    size_t index = 0;
+private:
+    size_t find(size_t index) const;
+};
+
+// Whole document lives in a single allocation, so creating and freeing it is one call to the allocator.
+// Copies of the document share that memory 
+struct frozen_document {
+    frozen_document() = default;
+    // Freezing the object. Later changes of the object don't affect the document 
+    explicit frozen_document(const object& object);
+    // Root object of the document. Empty object if nothing was frozen or parsed 
+    frozen_object root() const;
+    // Size of the tape in words and size of the string buffer in bytes
+    size_t tapeSize() const { return tapeWords; }
+    size_t stringsSize() const { return stringBytes; }
+    // Internal: memory holding the tape followed by the strings
+    std::shared_ptr<const void> storage;
+    const uint64_t* tape = nullptr;
+    size_t tapeWords = 0;
+    const char* strings = nullptr;
+    size_t stringBytes = 0;
+};
+
+// Positional index of a JSON file kept next to it in a sidecar file (see buildSidecar).
+// Both files are mapped read-only, values are found through the index and only their own text is parsed
+struct sidecar_index {
+    // Parsing the value at the JSON Pointer (RFC 6901), "" is the root object.
+    // Values below the indexed levels are taken from the parsed value of the deepest indexed one.
+    // Returns false if the pointer is malformed or there is no such value
+    bool get(std::string_view pointer, value& out) const;
+    // Internal: members of the indexed objects/arrays. Members of objects are sorted by the hash of their key,
+    // offsets point into the text, end is one past the last byte of the value
+    struct container {
+        uint64_t first;
+        uint64_t count;
+        uint64_t start;
+        uint64_t end;
+    };
+    struct entry {
+        // Offset of the quote opening the key, NO_OFFSET for elements of arrays
+        uint64_t key;
+        uint64_t hash;
+        uint64_t start;
+        uint64_t end;
+        // Index of the container of the value, NO_OFFSET if it is not indexed
+        uint64_t child;
+    };
+    static constexpr uint64_t NO_OFFSET = ~uint64_t(0);
+    // Internal: mappings of the text and of the index
+    std::shared_ptr<const void> textStorage;
+    std::shared_ptr<const void> indexStorage;
+    std::string_view text;
+    const container* containers = nullptr;
+    size_t containerCount = 0;
+    const entry* entries = nullptr;
+    size_t entryCount = 0;
+};
+
+// Handler of the SAX-style MessagePack decoding. Receives the data without building any objects.
+// Strings point into the decoded buffer. Returning false stops the decoding 
+struct msgpackHandler {
+    virtual ~msgpackHandler() = default;
+    // Maps and arrays report the number of their elements 
+    virtual bool beginObject(size_t size) { (void)size; return true; }
+    virtual bool endObject() { return true; }
+    virtual bool beginArray(size_t size) { (void)size; return true; }
+    virtual bool endArray() { return true; }
+    // Key of the next value in the object 
+    virtual bool key(std::string_view key) { (void)key; return true; }
+    virtual bool value(std::string_view value) { (void)value; return true; }
+    virtual bool value(long long value) { (void)value; return true; }
+    virtual bool value(double value) { (void)value; return true; }
+    virtual bool value(bool value) { (void)value; return true; }
+    virtual bool null() { return true; }
+};
+
+// Decoder of concatenated MessagePack records that arrive in pieces
+struct msgpackStream {
+    msgpackStream();
+    ~msgpackStream();
+    msgpackStream(const msgpackStream&) = delete;
+    msgpackStream& operator=(const msgpackStream&) = delete;
+    // Adding the next piece of data. Records may be split between pieces in any way.
+    // Record is decoded as its data comes, each byte is read once
+    void feed(const uint8_t* data, size_t size);
+    // Decoding the next record. Returns 1 if a record was decoded, 0 if the next record isn't complete yet
+    // and -1 if it can't be decoded. After invalid data the stream keeps returning -1, 
+    // a well-formed record that doesn't fit into the value (duplicate keys) is skipped 
+    int next(json::value& value);
+    // Passing the next record to the handler, return values are the same. Parts of the record are passed as they come,
+    // calling the other next() in the middle of the record starts it again 
+    int next(msgpackHandler& handler);
+    // Bytes that are fed but not decoded yet
+    size_t buffered() const;
+private:
+    struct state;
+    int advance(char mode, msgpackHandler* handler);
+    std::vector<uint8_t> buffer;
+    // Start of the current record and the end of its part decoded so far
+    size_t start = 0;
+    size_t scanned = 0;
+    bool failed = false;
+    std::unique_ptr<state> impl;
+};
+
+// Settings of the parse (see parse below)
+struct parseConfig {
+    // Keeping numbers as their text (see rawNumber). Numbers are only checked during the parse
+    // and converted when they are read, output writes them exactly as they were in the text
+    bool lazyNumbers = false;
+};
+
+// Settings of ingestFiles
+struct ingestConfig {
+    // Threads parsing the loaded files. 0 means std::thread::hardware_concurrency()
+    unsigned parserThreads = 0;
+    // Reads kept in flight at the same time. Without io_uring that is the number of reading threads
+    unsigned readsInFlight = 32;
+    // Bytes of the files that are loaded but not parsed yet. Reading waits while the limit is reached
+    size_t maxBufferedBytes = size_t(256) << 20;
+    // Reading with io_uring when the kernel supports it, otherwise with pread on the reading threads
+    bool useIoUring = true;
+};
+
+// Parser keeping its memory between the documents. Buffers of the parser are kept by the parser itself,
+// objects, arrays and members of the recycled documents are kept on the free list and used by the next parse,
+// so parsing documents of the same shape stops allocating for them. Used by one thread at a time 
+struct parser {
+    parser();
+    ~parser();
+    parser(const parser&) = delete;
+    parser& operator=(const parser&) = delete;
+    // Same as json::parse 
+    int parse(std::istream &stream, object& object, exitCode& code);
+    int parse(std::string_view text, object& object, exitCode& code);
+    // Taking the structures of the object back. Object is cleared, objects and arrays inside of it 
+    // go to the free list with their buckets and capacity. Shared children (see COPY_SHARED) are just released 
+    void recycle(object& object);
+    // Number of objects, arrays and members kept, each (4096 by default). Structures above that are freed 
+    void setLimit(size_t limit);
+    // Number of objects, arrays and members on the free list
+    size_t recycled() const;
+private:
+    struct state;
+    std::unique_ptr<state> impl;
+};
+
+// Reading the elements of one array of the document one at a time. Only the current element is built, the rest
+// of the document is checked the same way as by parse without building anything, so memory stays at the size
+// of the biggest element. Duplicate keys are reported only inside of the elements. Stream/text has to outlive the reader
+struct arrayReader {
+    // Array at the JSON Pointer (RFC 6901), e.g. "/records". Malformed pointers match nothing
+    arrayReader(std::istream& stream, std::string_view pointer);
+    arrayReader(std::string_view text, std::string_view pointer);
+    ~arrayReader();
+    arrayReader(const arrayReader&) = delete;
+    arrayReader& operator=(const arrayReader&) = delete;
+    // Parsing the next element into out, the previous element in out is freed. Returns 1 with the element,
+    // 0 when there are no more: the rest of the document is parsed then and code holds PARSE_SUCCESS or the error
+    int next(value& out);
+    // Set once the array was reached. Document without it has no elements, but is still checked
+    bool found() const;
+    exitCode code;
+private:
+    struct state;
+    std::unique_ptr<state> impl;
+};
+
+// Reading documents written one after another into one stream or text. Documents may be separated by whitespace,
+// by the record separator 0x1E of RFC 7464 or by nothing. Every byte is read once. Stream/text has to outlive the reader
+struct documentReader {
+    documentReader(std::istream& stream);
+    documentReader(std::string_view text);
+    ~documentReader();
+    documentReader(const documentReader&) = delete;
+    documentReader& operator=(const documentReader&) = delete;
+    // Parsing the next document into out. Returns 1 with the document, 0 when there are no more (code holds PARSE_SUCCESS)
+    // or on error. Errors are located from the start of the reader, reading stops after them
+    int next(object& out);
+    // Bytes of the last document from the start of the reader: its first byte and one past its last
+    size_t begin = 0;
+    size_t end = 0;
+    exitCode code;
+private:
+    struct state;
+    std::unique_ptr<state> impl;
+};
+
+// --- PROJECTION ---
+// Paths of the document built by the projected parse (see parse below). Set up once, used by any number of parses
+struct projection {
+    // Adding the path as the JSON Pointer (RFC 6901), e.g. "/user/name" or "/items/0/id".
+    // "" selects the whole document. Returns false if the pointer is malformed
+    bool addPointer(std::string_view pointer);
+    // Adding the member of the root object, same as the pointer "/key"
+    void addKey(std::string_view key);
+    // Stopping once every member of the root object with a path is read. Parse returns 1 and PARSE_SUCCESS
+    // right there, the rest of the stream is left unread
+    bool stopWhenFound = false;
+    // With stopWhenFound, reading the rest of the text anyway to check it. Nothing more is built,
+    // errors in the rest are returned as usual 
+    bool checkRest = false;
+
+    // Internal. Trie of the tokens of the paths, node 0 is the root
+    struct tokenHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view token) const { return std::hash<std::string_view>{}(token); }
+    };
+    struct node {
+        std::unordered_map<std::string, size_t, tokenHash, std::equal_to<>> children;
+        // Whole subtree of the node is built
+        bool selected = false;
+    };
+    std::vector<node> nodes = std::vector<node>(1);
+    // Node reached from the node by the token, -1 if there is none
+    long child(size_t node, std::string_view token) const;
+};
+
+// --- PATHS ---
+// JSON Pointer (RFC 6901) split into its segments once, e.g. json::path::compile("/orders/0/items/3/price").
+// Hashes of the keys and indexes of the arrays are computed when the path is compiled, so walking the path
+// doesn't hash the keys again. Compiled path can be used with any number of objects
+struct path {
+    static path compile(std::string_view pointer);
+    // False if the pointer was malformed. Such path finds nothing
+    bool valid() const { return isValid; }
+    // Value at the path, nullptr if there is none. "" is the root object itself, it has no value
+    const value* find(const object& root) const;
+    // Getting the value at the path, same as object::get
+    bool get(const object& root, std::string& out) const;
+    bool get(const object& root, long long& out) const;
+    bool get(const object& root, double& out) const;
+    bool get(const object& root, bool& out) const;
+    bool get(const object& root, const object*& out) const;
+    bool get(const object& root, const array*& out) const;
+    // Internal: key of the member and the index of the element the segment stands for
+    struct segment {
+        std::string key;
+        size_t hash;
+        size_t index;
+        bool isIndex;
+    };
+    std::vector<segment> segments;
+    bool isValid = false;
+};
+
+// Many paths resolved together. Paths are kept as a tree of their segments, so the common beginnings 
+// of the paths are looked up once for all of them
+struct pathSet {
+    // Adding the path. Returns its number in the results of resolve
+    size_t add(const path& compiled);
+    size_t add(std::string_view pointer);
+    // Resolving every path in one walk of the object. out[i] is the value of path i, nullptr if there is none
+    void resolve(const object& root, std::vector<const value*>& out) const;
+    // Internal: tree of the segments, node 0 is the root object
+    struct node {
+        path::segment segment;
+        std::vector<size_t> children;
+        // Paths ending at the node
+        std::vector<size_t> paths;
+    };
+    std::vector<node> nodes = std::vector<node>(1);
+    size_t count = 0;
+};
+
+// --- ASYNC PARSING ---
+// Coroutine returning T. Task starts only when it is awaited by another task or started with start()
+template<typename T> struct task {
+    struct promise_type;
+    using handle = std::coroutine_handle<promise_type>;
+    struct promise_type {
+        std::optional<T> result;
+        // Coroutine awaiting the task, resumed when the task ends
+        std::coroutine_handle<> continuation;
+        task get_return_object() { return task(handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        struct finalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(handle self) noexcept {
+                std::coroutine_handle<> next = self.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        finalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(T&& value) { result.emplace(std::move(value)); }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    task(task&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+    task& operator=(task&& other) noexcept {
+        if(coroutine) coroutine.destroy();
+        coroutine = std::exchange(other.coroutine, nullptr);
+        return *this;
+    }
+    ~task() { if(coroutine) coroutine.destroy(); }
+    // Running the task until its first suspension when nothing awaits it 
+    void start() { coroutine.resume(); }
+    bool done() const { return coroutine.done(); }
+    // Result of the finished task
+    T& result() { return *coroutine.promise().result; }
+    // Awaiting the task from another coroutine
+    bool await_ready() { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+        coroutine.promise().continuation = caller;
+        return coroutine;
+    }
+    T await_resume() { return std::move(*coroutine.promise().result); }
+private:
+    explicit task(handle coroutine) : coroutine(coroutine) {}
+    handle coroutine;
+};
+
+// Reactor resuming the coroutines waiting for their file descriptors.
+// Custom reactors (of an event loop that is already used by the program) implement waitReadable and cancel
+struct executor {
+    virtual ~executor() = default;
+    // Resuming the coroutine once, when fd becomes readable (or is closed/fails).
+    // Returns false if fd can't be waited for, the coroutine continues right away then 
+    virtual bool waitReadable(int fd, std::coroutine_handle<> coroutine) = 0;
+    // Dropping the wait of the coroutine that is destroyed before fd became readable. 
+    // Coroutine must not be resumed after that 
+    virtual void cancel(int fd, std::coroutine_handle<> coroutine) = 0;
+};
+
+// Default reactor based on epoll. Used by one thread at a time 
+struct epollExecutor : executor {
+    epollExecutor();
+    ~epollExecutor();
+    epollExecutor(const epollExecutor&) = delete;
+    epollExecutor& operator=(const epollExecutor&) = delete;
+    bool waitReadable(int fd, std::coroutine_handle<> coroutine) override;
+    void cancel(int fd, std::coroutine_handle<> coroutine) override;
+    // Waiting for the events and resuming the coroutines until no coroutine waits for anything 
+    void run();
+    // Waiting for the events once, no longer than timeout milliseconds (-1 is forever).
+    // Returns the number of coroutines resumed 
+    int poll(int timeout);
+    // Number of coroutines waiting for their file descriptors 
+    size_t waiting() const { return waits.size(); }
+private:
+    int epoll = -1;
+    // Coroutines waiting for their file descriptors
+    std::unordered_set<void*> waits;
+};
+
 // Parser function 
 // Reads data from the stream 
 // Parses JSON, writes data to object and writes exit information to code 
 int parse(std::istream &stream, object& object, exitCode& code);
+// Parsing the text in memory. Faster than going through the stream, 
+// buffers of the parser are kept by the thread and reused by the next call 
+int parse(std::string_view text, object& object, exitCode& code);
+// Checking the text without building anything. Errors are the same as of parse, and
+// text that isn't well-formed UTF-8 gets PARSE_ERR_INVALID_UTF8 with the place of the first bad byte. 
+// Buffers are kept by the thread, so checking documents one after another stops allocating 
+int validate(std::string_view text, exitCode& code);
+// Parsing with the settings 
+int parse(std::istream &stream, object& object, exitCode& code, const parseConfig& config);
+int parse(std::string_view text, object& object, exitCode& code, const parseConfig& config);
+// Parsing only the paths of the projection. Containers on the way to the paths are built with just the selected members,
+// elements of arrays before the selected one are filled with null, so indexes stay the same.
+// Rest of the text is checked the same way, but skipped without building anything.
+// Duplicate keys are reported only inside of the built objects
+int parse(std::istream &stream, object& object, exitCode& code, const projection& paths);
+int parse(std::string_view text, object& object, exitCode& code, const projection& paths);
+// Parsing many independent documents on the thread pool. outs and codes are resized to the number of inputs,
+// document i is parsed into outs[i] and its exit information is written to codes[i].
+// Documents are handed to the threads one by one, biggest first, so a few huge documents don't finish last.
+// 0 threads means threadPool::shared(). Returns the number of documents parsed successfully
+size_t parseBatch(std::span<const std::string_view> inputs, std::vector<object>& outs, std::vector<exitCode>& codes, unsigned threads = 0);
+size_t parseBatch(std::span<const std::string_view> inputs, std::vector<object>& outs, std::vector<exitCode>& codes, threadPool& pool);
+// Parsing one huge document on the thread pool. Text is split into chunks of chunkBytes, the threads find
+// the strings and the structural characters of the chunks, then the object is built in one pass over the found positions.
+// Result and errors are the same as of parse, text of a single chunk is just parsed. 0 threads means threadPool::shared()
+int parseParallel(std::string_view text, object& object, exitCode& code, unsigned threads = 0, size_t chunkBytes = 1 << 24);
+int parseParallel(std::string_view text, object& object, exitCode& code, threadPool& pool, size_t chunkBytes = 1 << 24);
+// Loading and parsing many files. Files are read while the loaded ones are parsed on the parser threads.
+// callback gets the index of the file in paths, parsed object and exit information.
+// Files that can't be read get PARSE_ERR_IO. Callback is called from the parser threads, several calls can run at the same time.
+// Returns the number of files parsed successfully, after all the callbacks are done
+size_t ingestFiles(const std::vector<std::string>& paths, const std::function<void(size_t index, std::unique_ptr<object> object, const exitCode& code)>& callback, const ingestConfig& config = ingestConfig());
+// Parsing the text read from the non-blocking fd. Parser stops at the end of the data and waits on the executor
+// until more data arrives, so many slow sources can be parsed by one thread.
+// Reading stops when the root object ends or the fd reaches end of file, bytes read after the root are dropped.
+// code must live until the task ends. Task destroyed while it waits stops waiting on the executor.
+// Parse ends with PARSE_ERR_IO if the data isn't there yet and the executor can't wait for fd
+task<object> parseAsync(int fd, executor& executor, exitCode& code);
+// Keeping the bytes after the root for the next document. pending is parsed before reading from fd, 
+// and holds the bytes read after the root when the task ends. pending must live until the task ends 
+task<object> parseAsync(int fd, executor& executor, exitCode& code, std::string& pending);
+// Parsing straight into the frozen document, no object is built on the way.
+// Errors are the same as of the function above. On error document is left untouched 
+int parse(std::istream &stream, frozen_document& document, exitCode& code);
 void outputObject(std::ostream &stream, const json::object& object, int indent = 0);
+// Parallel output. Big subtrees are rendered into separate buffers on the thread pool 
+// and written to the stream in order. Output is the same as of the function above 
+void outputObject(std::ostream &stream, const json::object& object, const outputConfig& config);
+// Writing object in the canonical form (RFC 8785): no whitespace, keys sorted by their UTF-16 code units,
+// shortest form of doubles and minimal string escaping. Integers are written exactly as they are
+// Returns false if the object contains NaN or infinity, those have no canonical form
+bool outputCanonical(std::ostream &stream, const json::object& object);
+// Hashing the canonical form of the object without building the text.
+// Objects with the same data have the same hash, no matter in which order keys were added
+// Returns false (and leaves out untouched) in the same cases as outputCanonical
+bool hashCanonical(const json::object& object, uint64_t& out);
+bool hashCanonical(const json::object& object, hash128& out);
+// Writing the frozen document as a snapshot. Snapshot holds no pointers, 
+// so it is loaded by mapping the file into memory, without parsing 
+bool saveSnapshot(std::ostream &stream, const frozen_document& document);
+// Mapping the snapshot read-only. Processes that map the same file share its pages.
+// verify checks every index of the tape first, which reads the whole file. Can be turned off for trusted files 
+// Returns false if the file can't be mapped or isn't a valid snapshot, document is left untouched then 
+bool loadSnapshot(const std::string& path, frozen_document& document, bool verify = true);
+// Building the positional index of the JSON file for sidecar_index. Members of the root object and of the containers
+// of the next levels - 1 levels are recorded with the offsets of their keys and values, deeper values only with their offsets.
+// Text is checked with validate first and gets its error. Files that can't be read or written get PARSE_ERR_IO.
+// Text that passes the validation but can't be indexed gets PARSE_UNHANDLED_ERROR at the place it stopped
+int buildSidecar(const std::string& path, const std::string& indexPath, exitCode& code, unsigned levels = 4);
+// Mapping the file and its index. verify checks every offset of the index, which reads the whole index.
+// Returns false if a file can't be mapped, the index is not valid or the file changed after the index was built
+bool loadSidecar(const std::string& path, const std::string& indexPath, sidecar_index& index, bool verify = true);
+// Encoding to CBOR (RFC 8949). Encoded data is appended to out.
+// Objects are written as maps with text keys, doubles in the shortest form that keeps their value 
+void encodeCBOR(const json::object& object, std::vector<uint8_t>& out);
+void encodeCBOR(const json::array& array, std::vector<uint8_t>& out);
+void encodeCBOR(const json::value& value, std::vector<uint8_t>& out);
+// Decoding CBOR straight into the object/array/value. Data has to be exactly one item: 
+// a map for the object, an array for the array or anything for the value.
+// Map keys have to be text and unique, integers have to fit into long long, byte strings aren't supported.
+// Tags are skipped, undefined is read as null. On error false is returned, object/array may hold the part decoded so far 
+bool decodeCBOR(const uint8_t* data, size_t size, json::object& object);
+bool decodeCBOR(const uint8_t* data, size_t size, json::array& array);
+bool decodeCBOR(const uint8_t* data, size_t size, json::value& value);
+// Encoding to MessagePack, data is appended to out. Doubles are written as float 32 if that keeps their value.
+// Returns false and leaves out as it was if a string, an object or an array has 2^32 or more bytes/members/elements,
+// MessagePack has no sizes for them 
+bool encodeMsgPack(const json::object& object, std::vector<uint8_t>& out);
+bool encodeMsgPack(const json::array& array, std::vector<uint8_t>& out);
+bool encodeMsgPack(const json::value& value, std::vector<uint8_t>& out);
+// Decoding MessagePack, same rules as decodeCBOR: exactly one item, str keys, integers that fit into long long.
+// bin and ext aren't supported. For concatenated records see msgpackStream 
+bool decodeMsgPack(const uint8_t* data, size_t size, json::object& object);
+bool decodeMsgPack(const uint8_t* data, size_t size, json::array& array);
+bool decodeMsgPack(const uint8_t* data, size_t size, json::value& value);
+// Passing the data to the handler instead of building the value 
+bool decodeMsgPack(const uint8_t* data, size_t size, msgpackHandler& handler);
 }
+
+#endif
@@ -0,0 +1,95 @@
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+struct json::parser::state {
+    parserScratch scratch;
+    nodePool pool;
+    size_t limit = 4096;
+};
+
+json::parser::parser() : impl(std::make_unique<state>()) {}
+
+json::parser::~parser() = default;
+
+int json::parser::parse(std::istream &stream, json::object& object, json::exitCode& code) {
+    domBuilder builder(object);
+    builder.pool = &impl->pool;
+    return parseText(stream, builder, code, impl->scratch);
+}
+
+int json::parser::parse(std::string_view text, json::object& object, json::exitCode& code) {
+    bufferSource source{text.data(), text.data() + text.size()};
+    domBuilder builder(object);
+    builder.pool = &impl->pool;
+    return parseText(source, builder, code, impl->scratch);
+}
+
+// Taking the object/array out of the value, so it can be emptied and kept
+static void takeChild(json::value& value, std::vector<std::unique_ptr<json::object>>& objects, std::vector<std::unique_ptr<json::array>>& arrays) {
+    if(auto object = std::get_if<std::unique_ptr<json::object>>(&value.value)) objects.push_back(std::move(*object));
+    else if(auto array = std::get_if<std::unique_ptr<json::array>>(&value.value)) arrays.push_back(std::move(*array));
+    value.value = std::monostate{};
+}
+
+void json::parser::recycle(json::object& root) {
+    nodePool& pool = impl->pool;
+    size_t limit = impl->limit;
+    // Structures whose children are not taken yet. Walk is iterative, see reclaim.cpp
+    std::vector<std::unique_ptr<json::object>> objects;
+    std::vector<std::unique_ptr<json::array>> arrays;
+
+    auto takeMembers = [&](json::object& object) {
+        while(!object.data.empty()) {
+            nodePool::entry entry = object.data.extract(object.data.begin());
+            takeChild(entry.mapped(), objects, arrays);
+            if(pool.entries.size() < limit) pool.entries.push_back(std::move(entry));
+        }
+    };
+
+    root.invalidate();
+    takeMembers(root);
+    while(!objects.empty() || !arrays.empty()) {
+        if(!objects.empty()) {
+            std::unique_ptr<json::object> object = std::move(objects.back());
+            objects.pop_back();
+            takeMembers(*object);
+            if(pool.objects.size() >= limit) continue;
+            object->parent = nullptr;
+            object->parentArray = nullptr;
+            object->cacheOutput = false;
+            object->outputCache.clear();
+            object->outputCacheIndent = -1;
+            object->outputDirty = true;
+            object->share.reset();
+            pool.objects.push_back(std::move(object));
+        } else {
+            std::unique_ptr<json::array> array = std::move(arrays.back());
+            arrays.pop_back();
+            for(auto& val: array->data) takeChild(val, objects, arrays);
+            array->data.clear();
+            if(pool.arrays.size() >= limit) continue;
+            array->parentArray = nullptr;
+            array->parentObject = nullptr;
+            array->cacheOutput = false;
+            array->outputCache.clear();
+            array->outputCacheIndent = -1;
+            array->outputDirty = true;
+            array->share.reset();
+            pool.arrays.push_back(std::move(array));
+        }
+    }
+    root.clear();
+}
+
+void json::parser::setLimit(size_t limit) {
+    impl->limit = limit;
+    nodePool& pool = impl->pool;
+    if(pool.objects.size() > limit) pool.objects.resize(limit);
+    if(pool.arrays.size() > limit) pool.arrays.resize(limit);
+    while(pool.entries.size() > limit) pool.entries.pop_back();
+}
+
+size_t json::parser::recycled() const {
+    const nodePool& pool = impl->pool;
+    return pool.objects.size() + pool.arrays.size() + pool.entries.size();
+}
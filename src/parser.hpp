@@ -0,0 +1,844 @@
+#ifndef PARSER_HPP
+#define PARSER_HPP
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "parkinson.hpp"
+
+// Internal header of the parser.
+// Parser reads the text and hands the data to the builder, so the same parser
+// can build json::object, frozen_document or anything else
+
+// Internal structure that indicated state of the parser
+enum parserState {
+    WAITING_FOR_OBJECT,
+    // KEY STATES
+    BEGIN_KEY,
+    WRITE_KEY,
+    KEY_WRITTEN,
+    // VALUE STATES
+    BEGIN_VALUE,
+    WRITE_VALUE,
+    VALUE_WRITTEN,
+};
+
+// --- Declaration of misc functions (see parkinson.cpp) ---
+bool processString(std::string &in, std::string &out);
+bool isWhole(const std::string& s);
+bool processNumber(std::string &in);
+// Error at the known place
+void constructExitCode(json::exitCode& exitStruct, json::parseRetVal code, int lineNumber, int characterNumber);
+// Error at the byte offset of the text. Line and character are filled later by the source (see bufferSource::locate)
+void constructExitCode(json::exitCode& exitStruct, json::parseRetVal code, size_t offset);
+int isContextArray(json::array* aCtx, json::object* oCtx);
+
+// --- Character classes ---
+// Every character is classified with one lookup in the 256-entry table instead of a chain of comparisons
+enum charClass : uint8_t {
+    CHAR_WHITESPACE = 1,
+    // Whitespace, ',', ']' and '}' end numbers and literals
+    CHAR_VALUE_END = 2,
+    // '"' and '\\' stop the copying of strings
+    CHAR_STRING_STOP = 4,
+    // Characters of numbers
+    CHAR_NUMBER = 8
+};
+
+// Value types by their first character, NO_VALUE if the character can't start a value
+constexpr uint8_t NO_VALUE = 0xff;
+
+struct charTables {
+    std::array<uint8_t, 256> classes{};
+    std::array<uint8_t, 256> valueTypes{};
+};
+
+constexpr charTables makeCharTables() {
+    charTables tables;
+    tables.valueTypes.fill(NO_VALUE);
+    for(unsigned char ch: {' ', '\t', '\r', '\n'}) tables.classes[ch] |= CHAR_WHITESPACE | CHAR_VALUE_END;
+    for(unsigned char ch: {',', ']', '}'}) tables.classes[ch] |= CHAR_VALUE_END;
+    for(unsigned char ch: {'"', '\\'}) tables.classes[ch] |= CHAR_STRING_STOP;
+    for(unsigned char ch: {'-', '.', 'e', '+'}) tables.classes[ch] |= CHAR_NUMBER;
+    for(unsigned char ch = '0'; ch <= '9'; ch++) {
+        tables.classes[ch] |= CHAR_NUMBER;
+        tables.valueTypes[ch] = json::JSON_NUMBER;
+    }
+    tables.valueTypes['-'] = json::JSON_NUMBER;
+    tables.valueTypes['.'] = json::JSON_NUMBER;
+    tables.valueTypes['"'] = json::JSON_STRING;
+    tables.valueTypes['['] = json::JSON_ARRAY;
+    tables.valueTypes['{'] = json::JSON_OBJECT;
+    tables.valueTypes['t'] = json::JSON_BOOL;
+    tables.valueTypes['f'] = json::JSON_BOOL;
+    tables.valueTypes['n'] = json::JSON_NULL;
+    return tables;
+}
+
+inline constexpr charTables CHAR_TABLES = makeCharTables();
+
+inline bool hasClass(char ch, uint8_t mask) {
+    return CHAR_TABLES.classes[static_cast<unsigned char>(ch)] & mask;
+}
+
+inline int isWhiteSpace(char ch) { return hasClass(ch, CHAR_WHITESPACE); }
+inline int checkStringEnd(char ch) { return ch == '"'; }
+inline int isNumber(char ch) { return hasClass(ch, CHAR_NUMBER); }
+
+// Setting the type of the value started by the character. -1 (and type untouched) if no value starts with it
+inline int detectValueType(char ch, json::types& type) {
+    uint8_t found = CHAR_TABLES.valueTypes[static_cast<unsigned char>(ch)];
+    if(found == NO_VALUE) return -1;
+    type = json::types(found);
+    return json::PARSE_SUCCESS;
+}
+
+// --- Numbers ---
+// Checking the number against the JSON grammar in one pass, whole is set if it has no fraction and no exponent
+inline bool checkNumber(const std::string& text, bool& whole) {
+    auto digit = [](char ch) { return ch >= '0' && ch <= '9'; };
+    size_t i = 0;
+    size_t size = text.size();
+    if(i < size && text[i] == '-') i++;
+    if(i >= size) return false;
+    if(text[i] == '0') {
+        i++;
+        if(i < size && digit(text[i])) return false;
+    } else if(digit(text[i])) {
+        while(i < size && digit(text[i])) i++;
+    } else {
+        return false;
+    }
+    whole = true;
+    if(i < size && text[i] == '.') {
+        whole = false;
+        i++;
+        if(i >= size || !digit(text[i])) return false;
+        while(i < size && digit(text[i])) i++;
+    }
+    if(i < size && (text[i] == 'e' || text[i] == 'E')) {
+        whole = false;
+        i++;
+        if(i < size && (text[i] == '+' || text[i] == '-')) i++;
+        if(i >= size || !digit(text[i])) return false;
+        while(i < size && digit(text[i])) i++;
+    }
+    return i == size;
+}
+
+// Value of the checked whole number. 18 digits always fit into long long, longer numbers are left to strtoll
+inline long long readWhole(const std::string& text) {
+    bool negative = text[0] == '-';
+    if(text.size() - negative > 18) return std::strtoll(text.c_str(), nullptr, 10);
+    long long value = 0;
+    for(size_t i = negative; i < text.size(); i++) value = value * 10 + (text[i] - '0');
+    return negative ? -value : value;
+}
+
+// Value of the checked number. Returns false if it is out of the range of double, numbers too small for it become 0
+inline bool readReal(const std::string& text, double& value) {
+    if(std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc()) return true;
+    // from_chars gives up on both overflow and underflow, strtod tells them apart
+    errno = 0;
+    value = std::strtod(text.c_str(), nullptr);
+    return !(errno == ERANGE && !std::isfinite(value));
+}
+
+// Buffers of the parser. Kept between the calls, they stop allocating once they are big enough
+struct parserScratch {
+    std::string context;
+    std::string tmpKey;
+    std::string key;
+    std::string tmpVal;
+    // Unescaped string value. Builders that don't keep the value leave its memory here
+    std::string processed;
+    void clear() {
+        context.clear();
+        tmpKey.clear();
+        key.clear();
+        tmpVal.clear();
+        processed.clear();
+    }
+};
+
+// Counting lines and characters the way errors report them, tab counts as 4 characters
+struct lineCounter {
+    int line = 1;
+    int character = 1;
+    void add(char ch) {
+        if(ch == '\n') {
+            line++;
+            character = 1;
+        } else if(ch == '\t') {
+            character += 4;
+        } else {
+            character++;
+        }
+    }
+};
+
+// Setting line and character of the error from the first length bytes of the text 
+inline void locateText(json::exitCode& code, const char* text, size_t length) {
+    lineCounter counter;
+    for(size_t i = 0; i < length; i++) counter.add(text[i]);
+    code.lineNumber = counter.line;
+    code.characterNumber = counter.character;
+}
+
+// Sources of the text. get(char&) is false when the text ends.
+// Parser counts only the bytes, locate(code) finds the line and character once the parse has failed
+
+// Source reading the text from the memory
+struct bufferSource {
+    const char* at;
+    const char* end;
+    const char* begin = at;
+    bool get(char& ch) {
+        if(at == end) return false;
+        ch = *at++;
+        return true;
+    }
+    void locate(json::exitCode& code) { locateText(code, begin, code.offset); }
+};
+
+// Get area of the streambuf. Its members are protected, so they are reached through the pointers taken in the derived class
+struct getArea : std::streambuf {
+    static constexpr char* (std::streambuf::*next)() const = &getArea::gptr;
+    static constexpr char* (std::streambuf::*end)() const = &getArea::egptr;
+    static constexpr void (std::streambuf::*advance)(int) = &getArea::gbump;
+};
+
+// Source reading the std::istream. Stream that can seek is read again from the start of the parse to find the error,
+// otherwise lines are counted while reading 
+struct streamSource {
+    std::istream& stream;
+    std::istream::pos_type start;
+    bool counting;
+    lineCounter counter;
+
+    streamSource(std::istream& stream) : stream(stream), start(stream.tellg()), counting(start == std::istream::pos_type(-1)) {}
+
+    bool get(char& ch) {
+        if(!stream.get(ch)) return false;
+        if(counting) counter.add(ch);
+        return true;
+    }
+
+    // Parsing the buffered text of the stream token by token (see textParser::feed), the stream is moved past the bytes
+    // the parser has read. Returns the same as feed(), -1 once the stream ends
+    template<typename Parser> int feed(Parser& parser) {
+        std::streambuf* buffer = stream.rdbuf();
+        int result = -1;
+        if(!stream) return result;
+        while(result < 0) {
+            // Filling the get area once it is read
+            if(buffer->sgetc() == std::char_traits<char>::eof()) {
+                stream.setstate(std::ios::eofbit | std::ios::failbit);
+                break;
+            }
+            const char* at = (buffer->*getArea::next)();
+            const char* end = (buffer->*getArea::end)();
+            if(at == end) {
+                // Streambuf without the get area gives the characters one by one
+                char ch;
+                get(ch);
+                result = parser.step(ch);
+            } else {
+                const char* from = at;
+                result = parser.feed(at, end);
+                if(counting) {
+                    for(const char* ch = from; ch != at; ch++) counter.add(*ch);
+                }
+                (buffer->*getArea::advance)(int(at - from));
+            }
+            if constexpr(requires { parser.builder.paused; }) {
+                if(parser.builder.paused) break;
+            }
+        }
+        return result;
+    }
+
+    void locate(json::exitCode& code) {
+        if(counting) {
+            code.lineNumber = counter.line;
+            code.characterNumber = counter.character;
+            return;
+        }
+        // Stream is left where the parser stopped
+        std::ios::iostate state = stream.rdstate();
+        stream.clear();
+        stream.seekg(start);
+        lineCounter again;
+        char ch;
+        for(size_t i = 0; i < code.offset && stream.get(ch); i++) again.add(ch);
+        code.lineNumber = again.line;
+        code.characterNumber = again.character;
+        stream.clear();
+        stream.seekg(start + std::streamoff(code.offset));
+        stream.setstate(state);
+    }
+};
+
+// Parser reads the text character by character and hands the data to the builder. 
+// Builder has to provide:
+//   void beginRoot()                    root object starts
+//   bool key(std::string& key)          key of the next value. Returns false if the key is a duplicate
+//   void beginObject(), beginArray()    object/array value starts
+//   void endObject(), endArray()        object/array ends, root object ends with endObject() as well
+//   void value(std::string&& value)     values, strings are already unescaped
+//   void value(long long value)
+//   void value(double value)
+//   void value(bool value)
+//   void null()
+// Builders that can keep numbers as the text also have bool lazyNumbers and void number(const std::string& text, bool whole).
+// Values and structures that follow key() belong to the object, others are elements of the array.
+
+// State of the parser between the characters, so the text can be given in pieces
+template<typename Builder> struct textParser {
+    Builder& builder;
+    json::exitCode& code;
+    // Bytes read, errors keep it in exitCode::offset 
+    size_t offset = 0;
+    parserState state = WAITING_FOR_OBJECT;
+    json::types type = json::JSON_NULL;
+    // Structures that are being parsed, 'o' for objects and 'a' for arrays
+    std::string& context;
+    //Key temp string
+    std::string& tmpKey;
+    std::string& key;
+    // Temp values of the pair
+    std::string& tmpVal;
+    std::string& processed;
+    bool prevBS = false;
+
+    textParser(Builder& builder, json::exitCode& code, parserScratch& scratch) 
+        : builder(builder), code(code), context(scratch.context), tmpKey(scratch.tmpKey), key(scratch.key), tmpVal(scratch.tmpVal), processed(scratch.processed) {
+        scratch.clear();
+    }
+
+    // Parsing the next character. Returns -1 if more text is needed, 
+    // 1 and PARSE_SUCCESS when the root object is closed, 0 and the error in the code on error 
+    int step(char ch) {
+        using namespace json;
+        offset++;
+
+        // Whitespace inside of keys and values is part of them
+        if(state != WRITE_VALUE && state != WRITE_KEY && isWhiteSpace(ch)) {
+           return -1;
+        }
+
+        switch (state) {
+            // BEGINNING OF THE OBJECT PARSING
+            case WAITING_FOR_OBJECT: {
+                if(ch == '{') {
+                    state = BEGIN_KEY;
+                    context.push_back('o');
+                    builder.beginRoot();
+                }
+                else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_OBJECT_START, offset);
+                    return 0;
+                }
+                break;
+            }
+            // BEGINNING OF KEY WRITING
+            case BEGIN_KEY: {
+                if(ch == '"') {
+                    state = WRITE_KEY;
+                    prevBS = false;
+                } else if(ch == '}') {
+                    state = VALUE_WRITTEN;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_KEY_DECLARATION, offset);
+                    return 0;
+                }
+                break;
+            }
+            // WRITING THE KEY
+            case WRITE_KEY: {
+                if(ch == '"' && !prevBS) {
+                    state = KEY_WRITTEN;
+                    if(!processString(tmpKey, key)) {
+                        constructExitCode(code, PARSE_ERR_INCORRECT_UNICODE_ESC_IN_KEY, offset);
+                        return 0;
+                    }
+                    if(!builder.key(key)){
+                        constructExitCode(code, PARSE_ERR_DUPLICATE_ELEMENTS, offset);
+                        return 0;
+                    }
+                    key.clear();
+                    tmpKey.clear();
+                } else {
+                    tmpKey += ch;
+                    prevBS = (ch == '\\' && !prevBS);
+                }
+                break;
+            }
+            // CHECKING SEPARATOR BETWEEN KEY AND VALUE
+            case KEY_WRITTEN: {
+                if(ch == ':') {
+                    state = BEGIN_VALUE;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_KEY_VALUE_SEPARATOR, offset);
+                    return 0;
+                }
+                break;
+            }
+            // CHECKING VALUE TYPE
+            case BEGIN_VALUE: {
+                prevBS = false;
+                int retCode = detectValueType(ch, type);
+                if(ch == '}') {
+                    constructExitCode(code, PARSER_ERR_COMMA_AFTER_LAST_ELEMENT, offset);
+                    return 0;
+                } else if(ch == ']') {
+                    if(type == JSON_ARRAY) {
+                        state = VALUE_WRITTEN;
+                        break;
+                    } else {
+                        constructExitCode(code, PARSER_ERR_COMMA_AFTER_LAST_ELEMENT, offset);
+                        return 0;
+                    }
+                }
+                if(retCode == -1) {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_VALUE_TYPE, offset);
+                    return 0;
+                }
+                if(type == JSON_NUMBER || type == JSON_BOOL || type == JSON_NULL) {
+                    tmpVal += ch;
+                } else if(type == JSON_ARRAY) {
+                    builder.beginArray();
+                    context.push_back('a');
+                    state = BEGIN_VALUE;
+                    tmpVal.clear();
+                    break;
+                } else if(type == JSON_OBJECT) {
+                    builder.beginObject();
+                    context.push_back('o');
+                    state = BEGIN_KEY;
+                    tmpVal.clear();
+                    break;
+                }
+                state = WRITE_VALUE;
+                break;
+            }
+            // WRITING VALUE DEPENDING ON THE VALUE TYPE
+            case WRITE_VALUE: {
+                switch (type) {
+                    // --- Writing string values ---
+                    case JSON_STRING: {
+                        if(checkStringEnd(ch) && !prevBS) {
+                            processed.clear();
+                            if(!processString(tmpVal, processed)) {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_UNICODE_DECLARATION, offset);
+                                return 0;
+                            }
+                            builder.value(std::move(processed));
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                            return -1;
+                        } else {
+                            tmpVal += ch;
+                            prevBS = (ch == '\\' && !prevBS);
+                        }
+                        break;
+                    }
+                    // --- Writing number (int/float) values ---
+                    case JSON_NUMBER: {
+                        if(hasClass(ch, CHAR_VALUE_END)) {
+                            bool isInt = false;
+                            if(!checkNumber(tmpVal, isInt)) {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_NUMBER_DEFINITION, offset);
+                                return 0;
+                            }
+                            // Builders with lazyNumbers set keep the text and convert it when it is read (see domBuilder)
+                            bool lazy = false;
+                            if constexpr(requires { builder.lazyNumbers; }) lazy = builder.lazyNumbers;
+                            if(isInt) {
+                                if(!lazy) builder.value(readWhole(tmpVal));
+                            // Only numbers with an exponent or hundreds of digits can be out of the range of double,
+                            // lazy numbers skip the conversion otherwise 
+                            } else if(!lazy || tmpVal.size() > 300 || tmpVal.find_first_of("eE") != std::string::npos) {
+                                double d;
+                                if(!readReal(tmpVal, d)) {
+                                    constructExitCode(code, PARSE_ERR_NUMBER_OVERFLOW_OR_UNDERFLOW, offset);
+                                    return 0;
+                                }
+                                if(!lazy) builder.value(d);
+                            }
+                            if constexpr(requires { builder.lazyNumbers; }) {
+                                if(lazy) builder.number(tmpVal, isInt);
+                            }
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                        } else {
+                            tmpVal += ch;
+                        }
+                        break;
+                    }
+                    // --- Writing boolean variable ---
+                    case JSON_BOOL: {
+                        if(hasClass(ch, CHAR_VALUE_END)) {
+                            // If value in the buffer is "true" make true
+                            if(tmpVal == std::string("true")) {
+                                builder.value(true);
+                            }
+                            // If value in buffer is "false" make false
+                            else if(tmpVal == std::string("false")) {
+                                builder.value(false);
+                            }
+                            // If neither - throw an error
+                            else {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_BOOL_DEFINITION, offset);
+                                return 0;
+                            }
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                        } else {
+                            tmpVal += ch;
+                        }
+                        break;
+                    }
+                    case JSON_NULL: {
+                        if(hasClass(ch, CHAR_VALUE_END)) {
+                            if(tmpVal == std::string("null")) {
+                                builder.null();
+                            } else {
+                                constructExitCode(code, PARSE_ERR_INCORRECT_NULL_VALUE_DEFINITION, offset);
+                                return 0;
+                            }
+                            state = VALUE_WRITTEN;
+                            tmpVal.clear();
+                        } else {
+                            tmpVal += ch;
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                break;
+            }
+            // What to do when the value is written
+            case VALUE_WRITTEN:
+                break;
+        }
+        // If value is written, outside of the switch case it will be checked
+        if (state == VALUE_WRITTEN) {
+            if(isWhiteSpace(ch)) return -1;
+            if(context.back() == 'a') {
+                if(ch == ',') {
+                    state = BEGIN_VALUE;
+                }
+                else if(ch == ']') {
+                    builder.endArray();
+                    context.pop_back();
+                    state = VALUE_WRITTEN;
+                } else if(ch == '}') {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_ARRAY_ENDING, offset);
+                    return 0;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_VALUE_ENDING, offset);
+                    return 0;
+                }
+            } else {
+                if(ch == ',') state = BEGIN_KEY;
+                else if(ch == '}') {
+                    builder.endObject();
+                    context.pop_back();
+                    if(context.empty()) {
+                        constructExitCode(code, PARSE_SUCCESS, 0, 0);
+                        return 1;
+                    }
+                } else if(ch == ']') {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_OBJECT_ENDING, offset);
+                    return 0;
+                } else {
+                    constructExitCode(code, PARSE_ERR_INCORRECT_VALUE_ENDING, offset);
+                    return 0;
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Parsing the text in memory. Runs of characters that don't change the state (whitespace between the tokens,
+    // insides of strings, numbers and literals) are taken at once, characters ending them go through step().
+    // at is moved past the text that was read. Returns the same as step()
+    int feed(const char*& at, const char* end) {
+        using namespace json;
+        const char* stop;
+#if defined(__GNUC__)
+        // Jumping straight to the scan of the current state. Table is not static: static of the inline function
+        // is shared by all of its copies, and label addresses of one copy are wrong in the others
+        const void* const scans[] = {
+            &&structural, &&structural, &&keyText, &&structural, &&structural, &&valueText, &&structural
+        };
+        #define PARKINSON_NEXT_TOKEN goto *scans[state]
+#else
+        #define PARKINSON_NEXT_TOKEN \
+            switch(state) { \
+                case WRITE_KEY: goto keyText; \
+                case WRITE_VALUE: goto valueText; \
+                default: goto structural; \
+            }
+#endif
+        while(true) {
+            PARKINSON_NEXT_TOKEN;
+        structural:
+            stop = at;
+            while(stop != end && hasClass(*stop, CHAR_WHITESPACE)) stop++;
+            goto skip;
+        keyText:
+            stop = at;
+            while(stop != end && !hasClass(*stop, CHAR_STRING_STOP)) stop++;
+            tmpKey.append(at, stop - at);
+            goto copied;
+        valueText:
+            stop = at;
+            if(type == JSON_STRING) {
+                while(stop != end && !hasClass(*stop, CHAR_STRING_STOP)) stop++;
+            } else if(type == JSON_NUMBER || type == JSON_BOOL || type == JSON_NULL) {
+                while(stop != end && !hasClass(*stop, CHAR_VALUE_END)) stop++;
+            }
+            tmpVal.append(at, stop - at);
+        copied:
+            // Character after the backslash is in the run, so nothing is escaped anymore
+            if(stop != at) prevBS = false;
+        skip:
+            offset += stop - at;
+            at = stop;
+            if(at == end) return -1;
+            int result = step(*at++);
+            if(result >= 0) return result;
+            // Builders with paused set stop the parse between the tokens, feed can be called again to go on
+            if constexpr(requires { builder.paused; }) {
+                if(builder.paused) return -1;
+            }
+        }
+        #undef PARKINSON_NEXT_TOKEN
+    }
+
+    // Text ended before the root object was closed
+    int finish() {
+        constructExitCode(code, json::PARSE_ERR_INCORRECT_OBJECT_ENDING, offset);
+        return 0;
+    }
+};
+
+// Parsing the text from the source into the builder. 
+// Source is std::istream or one of the sources above. 
+// Returns 1 and PARSE_SUCCESS on success, otherwise 0 and the error in the code
+template<typename Source, typename Builder> int parseText(Source &source, Builder& builder, json::exitCode& code, parserScratch& scratch) {
+    if constexpr(std::is_base_of_v<std::istream, Source>) {
+        streamSource stream(source);
+        return parseText(stream, builder, code, scratch);
+    } else {
+        textParser<Builder> parser(builder, code, scratch);
+        int result = -1;
+        if constexpr(std::is_same_v<Source, bufferSource>) {
+            // Whole text is here, so it is taken token by token
+            result = parser.feed(source.at, source.end);
+        } else if constexpr(std::is_same_v<Source, streamSource>) {
+            result = source.feed(parser);
+        } else {
+            char ch;
+            while(result < 0 && source.get(ch)) result = parser.step(ch);
+        }
+        if(result < 0) result = parser.finish();
+        if(result == 0) source.locate(code);
+        return result;
+    }
+}
+
+template<typename Source, typename Builder> int parseText(Source &stream, Builder& builder, json::exitCode& code) {
+    parserScratch scratch;
+    return parseText(stream, builder, code, scratch);
+}
+
+// Value taken out of its parent doesn't point to it anymore
+inline void detachValue(json::value& value) {
+    if(auto object = std::get_if<std::unique_ptr<json::object>>(&value.value)) {
+        (*object)->parent = nullptr;
+        (*object)->parentArray = nullptr;
+    }
+    if(auto array = std::get_if<std::unique_ptr<json::array>>(&value.value)) {
+        (*array)->parentObject = nullptr;
+        (*array)->parentArray = nullptr;
+    }
+}
+
+// Unescaped tokens of the JSON Pointer (RFC 6901), "" has none. Returns false if the pointer is malformed (see projection.cpp)
+bool splitPointer(std::string_view pointer, std::vector<std::string>& tokens);
+
+// --- Structural index (see index.cpp) ---
+// Positions of the structural characters outside of strings and of the quotes around the strings.
+// Text is indexed in chunks on the threads, positions of each chunk are relative to its start
+struct structuralIndex {
+    size_t chunkBytes = 0;
+    std::vector<std::vector<uint32_t>> chunks;
+};
+
+// Finding the positions of the index block by block. State is carried from one call to the next,
+// so the text can be scanned in pieces that start at multiples of 64 bytes
+struct structuralScanner {
+    // Set if the next block starts with an escaped character
+    uint64_t escaped = 0;
+    // All bits are set if the next block starts inside of a string
+    uint64_t inString = 0;
+    // Appending the positions of [from, to) relative to from
+    void scan(std::string_view text, size_t from, size_t to, std::vector<uint32_t>& positions);
+};
+
+// Indexing the text in chunks of about chunkBytes on the pool
+void buildStructuralIndex(std::string_view text, json::threadPool& pool, size_t chunkBytes, structuralIndex& index);
+
+// Reading the positions of the index in the order of the text
+struct indexCursor {
+    const structuralIndex& index;
+    size_t chunk = 0;
+    size_t at = 0;
+    bool next(uint64_t& position) {
+        while(chunk < index.chunks.size()) {
+            const std::vector<uint32_t>& positions = index.chunks[chunk];
+            if(at < positions.size()) {
+                position = uint64_t(chunk) * index.chunkBytes + positions[at++];
+                return true;
+            }
+            chunk++;
+            at = 0;
+        }
+        return false;
+    }
+};
+
+// Structures and members of the parsed objects, kept for the next documents (see json::parser)
+struct nodePool {
+    using entry = json::members::node_type;
+    std::vector<std::unique_ptr<json::object>> objects;
+    std::vector<std::unique_ptr<json::array>> arrays;
+    // Members of the objects, with the memory of their keys
+    std::vector<entry> entries;
+
+    std::unique_ptr<json::object> takeObject() {
+        if(objects.empty()) return std::make_unique<json::object>();
+        std::unique_ptr<json::object> object = std::move(objects.back());
+        objects.pop_back();
+        return object;
+    }
+    std::unique_ptr<json::array> takeArray() {
+        if(arrays.empty()) return std::make_unique<json::array>();
+        std::unique_ptr<json::array> array = std::move(arrays.back());
+        arrays.pop_back();
+        return array;
+    }
+};
+
+// Builder that writes the parsed data into the json::object
+struct domBuilder {
+    json::object* currentObject;
+    json::array* currentArray = nullptr;
+    std::string currentKey;
+    // Structures are taken from the pool when it is set
+    nodePool* pool = nullptr;
+    // Numbers are kept as their text (see parseConfig::lazyNumbers)
+    bool lazyNumbers = false;
+
+    domBuilder(json::object& root) : currentObject(&root) {}
+    // Filling the array, used by decoders whose root is an array or a single value 
+    domBuilder(json::array& root) : currentObject(nullptr), currentArray(&root) {}
+
+    void beginRoot() {}
+
+    bool key(std::string& key) {
+        if(currentObject->data.contains(key)) return false;
+        currentKey = key;
+        return true;
+    }
+
+    // Inserting the value into the current context
+    json::value& insert(json::value&& v) {
+        if(isContextArray(currentArray, currentObject)) {
+            return currentArray->data.emplace_back(std::move(v));
+        }
+        if(pool != nullptr && !pool->entries.empty()) {
+            nodePool::entry entry = std::move(pool->entries.back());
+            pool->entries.pop_back();
+            // Key is copied into the memory of the recycled key
+            entry.key().assign(currentKey);
+            entry.mapped() = std::move(v);
+            return currentObject->data.insert(std::move(entry)).position->second;
+        }
+        auto insertResult = currentObject->data.emplace(std::move(currentKey), std::move(v));
+        currentKey.clear();
+        return insertResult.first->second;
+    }
+
+    void beginObject() {
+        json::value v;
+        v.type = json::JSON_OBJECT;
+        v.value = pool != nullptr ? pool->takeObject() : std::make_unique<json::object>();
+        bool inArray = isContextArray(currentArray, currentObject);
+        auto &objUPtr = std::get<std::unique_ptr<json::object>>(insert(std::move(v)).value);
+        json::object* objPtr = objUPtr.get();
+        if(inArray) objPtr->addParentArray(currentArray);
+        else objPtr->addParentObject(currentObject);
+        currentObject = objPtr;
+        currentArray = nullptr;
+    }
+
+    void beginArray() {
+        json::value v;
+        v.type = json::JSON_ARRAY;
+        v.value = pool != nullptr ? pool->takeArray() : std::make_unique<json::array>();
+        bool inArray = isContextArray(currentArray, currentObject);
+        auto &arrayUPtr = std::get<std::unique_ptr<json::array>>(insert(std::move(v)).value);
+        json::array* arrayPtr = arrayUPtr.get();
+        if(inArray) arrayPtr->addParentArray(currentArray);
+        else arrayPtr->addParentObject(currentObject);
+        currentArray = arrayPtr;
+        currentObject = nullptr;
+    }
+
+    void endObject() {
+        if(currentObject->parentArray != nullptr) {
+            currentArray = currentObject->parentArray;
+            currentObject = nullptr;
+        } else if(currentObject->parent != nullptr) {
+            currentObject = currentObject->parent;
+        }
+    }
+
+    void endArray() {
+        if(currentArray->parentArray != nullptr) {
+            currentArray = currentArray->parentArray;
+        } else {
+            currentObject = currentArray->parentObject;
+            currentArray = nullptr;
+        }
+    }
+
+    template<typename T> void scalar(json::types type, T&& value) {
+        json::value v;
+        v.type = type;
+        v.value = std::forward<T>(value);
+        insert(std::move(v));
+    }
+
+    void value(std::string&& value) { scalar(json::JSON_STRING, std::move(value)); }
+    void value(long long value) { scalar(json::JSON_NUMBER, value); }
+    void value(double value) { scalar(json::JSON_NUMBER, value); }
+    void value(bool value) { scalar(json::JSON_BOOL, value); }
+    void null() { scalar(json::JSON_NULL, std::monostate{}); }
+    void number(const std::string& text, bool whole) { scalar(json::JSON_NUMBER, json::rawNumber(text, whole)); }
+};
+
+#endif
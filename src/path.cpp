@@ -0,0 +1,137 @@
+#include <charconv>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// Segment carries the hash of its key, so the member is found without hashing the key again
+static const json::value* member(const json::object& object, const json::path::segment& segment) {
+    auto it = object.data.find(json::hashedKey{segment.key, segment.hash});
+    return it == object.data.end() ? nullptr : &it->second;
+}
+
+// Member or element of the object/array for the segment
+static const json::value* child(const json::object* object, const json::array* array, const json::path::segment& segment) {
+    if(object != nullptr) return member(*object, segment);
+    if(array != nullptr && segment.isIndex && segment.index < array->data.size()) return &array->data[segment.index];
+    return nullptr;
+}
+
+static const json::value* child(const json::value& value, const json::path::segment& segment) {
+    if(value.type == json::JSON_OBJECT) return child(value.getObject(), nullptr, segment);
+    if(value.type == json::JSON_ARRAY) return child(nullptr, value.getArray(), segment);
+    return nullptr;
+}
+
+json::path json::path::compile(std::string_view pointer) {
+    json::path compiled;
+    std::vector<std::string> tokens;
+    if(!splitPointer(pointer, tokens)) return compiled;
+    json::keyHash hasher;
+    for(auto& token: tokens) {
+        segment& added = compiled.segments.emplace_back();
+        added.hash = hasher(token);
+        // Array indexes are digits without leading zeros
+        auto result = std::from_chars(token.data(), token.data() + token.size(), added.index);
+        added.isIndex = !token.empty() && (token.size() == 1 || token[0] != '0')
+            && result.ec == std::errc() && result.ptr == token.data() + token.size();
+        added.key = std::move(token);
+    }
+    compiled.isValid = true;
+    return compiled;
+}
+
+const json::value* json::path::find(const json::object& root) const {
+    if(!isValid || segments.empty()) return nullptr;
+    const json::value* current = child(&root, nullptr, segments[0]);
+    for(size_t i = 1; i < segments.size() && current != nullptr; i++) current = child(*current, segments[i]);
+    return current;
+}
+
+bool json::path::get(const json::object& root, std::string& out) const {
+    const json::value* found = find(root);
+    if(found == nullptr || found->type != JSON_STRING) return false;
+    out = std::get<std::string>(found->value);
+    return true;
+}
+
+bool json::path::get(const json::object& root, long long& out) const {
+    const json::value* found = find(root);
+    if(found == nullptr || found->type != JSON_NUMBER) return false;
+    return found->getNumber(out);
+}
+
+bool json::path::get(const json::object& root, double& out) const {
+    const json::value* found = find(root);
+    if(found == nullptr || found->type != JSON_NUMBER) return false;
+    return found->getNumber(out);
+}
+
+bool json::path::get(const json::object& root, bool& out) const {
+    const json::value* found = find(root);
+    if(found == nullptr || found->type != JSON_BOOL) return false;
+    out = std::get<bool>(found->value);
+    return true;
+}
+
+bool json::path::get(const json::object& root, const json::object*& out) const {
+    if(isValid && segments.empty()) {
+        out = &root;
+        return true;
+    }
+    const json::value* found = find(root);
+    if(found == nullptr || found->type != JSON_OBJECT) return false;
+    out = found->getObject();
+    return true;
+}
+
+bool json::path::get(const json::object& root, const json::array*& out) const {
+    const json::value* found = find(root);
+    if(found == nullptr || found->type != JSON_ARRAY) return false;
+    out = found->getArray();
+    return true;
+}
+
+size_t json::pathSet::add(const json::path& compiled) {
+    size_t number = count++;
+    if(!compiled.valid()) return number;
+    size_t current = 0;
+    for(auto& segment: compiled.segments) {
+        size_t next = 0;
+        for(size_t candidate: nodes[current].children) {
+            if(nodes[candidate].segment.key == segment.key) {
+                next = candidate;
+                break;
+            }
+        }
+        if(next == 0) {
+            next = nodes.size();
+            nodes.push_back({segment, {}, {}});
+            nodes[current].children.push_back(next);
+        }
+        current = next;
+    }
+    nodes[current].paths.push_back(number);
+    return number;
+}
+
+size_t json::pathSet::add(std::string_view pointer) {
+    return add(json::path::compile(pointer));
+}
+
+void json::pathSet::resolve(const json::object& root, std::vector<const json::value*>& out) const {
+    out.assign(count, nullptr);
+    // Nodes whose value is found and whose children are not resolved yet
+    std::vector<std::pair<size_t, const json::value*>> pending;
+    for(size_t node: nodes[0].children) {
+        const json::value* found = child(&root, nullptr, nodes[node].segment);
+        if(found != nullptr) pending.emplace_back(node, found);
+    }
+    while(!pending.empty()) {
+        auto [node, value] = pending.back();
+        pending.pop_back();
+        for(size_t number: nodes[node].paths) out[number] = value;
+        for(size_t next: nodes[node].children) {
+            const json::value* found = child(*value, nodes[next].segment);
+            if(found != nullptr) pending.emplace_back(next, found);
+        }
+    }
+}
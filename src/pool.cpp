@@ -0,0 +1,71 @@
+#include "parkinson.hpp"
+
+json::threadPool::threadPool(unsigned threads) {
+    if(threads == 0) threads = std::thread::hardware_concurrency();
+    if(threads == 0) threads = 1;
+    // Calling thread is one of the workers of the job
+    workers.reserve(threads - 1);
+    for(unsigned i = 1; i < threads; i++) {
+        workers.emplace_back([this]() {
+            unsigned long seen = 0;
+            std::unique_lock<std::mutex> lk(lock);
+            while(true) {
+                wake.wait(lk, [&]() { return stop || generation != seen; });
+                if(stop) return;
+                seen = generation;
+                job &j = *current;
+                lk.unlock();
+                work(j);
+                lk.lock();
+                if(--active == 0) finished.notify_one();
+            }
+        });
+    }
+}
+
+json::threadPool::~threadPool() {
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    for(auto &t: workers) t.join();
+}
+
+unsigned json::threadPool::size() const {
+    return workers.size() + 1;
+}
+
+void json::threadPool::work(job& j) {
+    size_t i;
+    while((i = j.next.fetch_add(1, std::memory_order_relaxed)) < j.count) {
+        (*j.fn)(i);
+    }
+}
+
+void json::threadPool::run(size_t count, const std::function<void(size_t)>& fn) {
+    if(count == 0) return;
+    if(workers.empty() || count == 1) {
+        for(size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+    // Only one job at a time runs on the pool
+    std::lock_guard<std::mutex> runLk(runLock);
+    job j{ &fn, count, {0} };
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        current = &j;
+        active = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    work(j);
+    std::unique_lock<std::mutex> lk(lock);
+    finished.wait(lk, [&]() { return active == 0; });
+    current = nullptr;
+}
+
+json::threadPool& json::threadPool::shared() {
+    static threadPool pool;
+    return pool;
+}
@@ -0,0 +1,221 @@
+#include <charconv>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+long json::projection::child(size_t node, std::string_view token) const {
+    auto& children = nodes[node].children;
+    if(children.empty()) return -1;
+    auto it = children.find(token);
+    return it == children.end() ? -1 : long(it->second);
+}
+
+bool splitPointer(std::string_view pointer, std::vector<std::string>& tokens) {
+    if(!pointer.empty() && pointer[0] != '/') return false;
+    tokens.clear();
+    size_t at = 0;
+    while(at < pointer.size()) {
+        at++;
+        std::string& token = tokens.emplace_back();
+        while(at < pointer.size() && pointer[at] != '/') {
+            char c = pointer[at++];
+            if(c == '~') {
+                if(at == pointer.size()) return false;
+                c = pointer[at++];
+                if(c == '0') c = '~';
+                else if(c == '1') c = '/';
+                else return false;
+            }
+            token += c;
+        }
+    }
+    return true;
+}
+
+bool json::projection::addPointer(std::string_view pointer) {
+    // Tokens are unescaped first, so the malformed pointer adds nothing
+    std::vector<std::string> tokens;
+    if(!splitPointer(pointer, tokens)) return false;
+    size_t node = 0;
+    for(auto& token: tokens) {
+        auto it = nodes[node].children.find(token);
+        if(it != nodes[node].children.end()) {
+            node = it->second;
+            continue;
+        }
+        size_t next = nodes.size();
+        nodes[node].children.emplace(std::move(token), next);
+        nodes.emplace_back();
+        node = next;
+    }
+    nodes[node].selected = true;
+    return true;
+}
+
+void json::projection::addKey(std::string_view key) {
+    auto it = nodes[0].children.find(key);
+    if(it != nodes[0].children.end()) {
+        nodes[it->second].selected = true;
+        return;
+    }
+    nodes[0].children.emplace(std::string(key), nodes.size());
+    nodes.emplace_back().selected = true;
+}
+
+// Builder handing only the selected values to the domBuilder. Skipped values are dropped as they come,
+// their strings stay in the scratch of the parser
+struct projectionBuilder {
+    static constexpr long SKIP = -1;
+    static constexpr long BUILD = -2;
+
+    struct frame {
+        size_t node;
+        bool array;
+        // Elements seen and built, for the arrays
+        size_t index;
+        size_t built;
+    };
+
+    domBuilder dom;
+    const json::projection& paths;
+    // Containers on the way to the selected paths
+    std::vector<frame> path;
+    // Depth inside of the selected subtree, everything there is built
+    size_t selectedDepth = 0;
+    // Depth inside of the skipped subtree
+    size_t skippedDepth = 0;
+    // Node of the member whose key was read last
+    long memberNode = SKIP;
+    // Node of the current member of the root object
+    long rootMember = SKIP;
+    // Members of the root object with paths that are not read yet
+    size_t remaining = 0;
+    // Everything needed is read, the rest is skipped
+    bool complete = false;
+
+    projectionBuilder(json::object& root, const json::projection& paths) : dom(root), paths(paths) {}
+
+    // What to do with the next value: BUILD it whole, SKIP it or follow the node of the projection 
+    long next() {
+        if(skippedDepth > 0 || complete) return SKIP;
+        if(selectedDepth > 0) return BUILD;
+        frame& top = path.back();
+        long node = memberNode;
+        if(top.array) {
+            char digits[24];
+            char* end = std::to_chars(digits, digits + sizeof(digits), top.index).ptr;
+            node = paths.child(top.node, std::string_view(digits, end - digits));
+            top.index++;
+        }
+        if(node >= 0 && paths.nodes[node].selected) return BUILD;
+        return node;
+    }
+
+    // Filling the skipped elements before the built one, so indexes of the array stay the same
+    void place() {
+        if(selectedDepth > 0) return;
+        frame& top = path.back();
+        if(!top.array) return;
+        while(top.built + 1 < top.index) {
+            dom.null();
+            top.built++;
+        }
+        top.built++;
+    }
+
+    // Counting the members of the root object with paths, once all of them are read the parse can stop
+    void memberEnded() {
+        if(path.size() != 1 || selectedDepth > 0 || skippedDepth > 0 || rootMember < 0) return;
+        rootMember = SKIP;
+        if(remaining > 0 && --remaining == 0) complete = paths.stopWhenFound;
+    }
+
+    void beginRoot() {
+        if(paths.nodes[0].selected) selectedDepth = 1;
+        else path.push_back({0, false, 0, 0});
+        remaining = paths.nodes[0].selected ? 0 : paths.nodes[0].children.size();
+        dom.beginRoot();
+    }
+
+    bool key(std::string& key) {
+        if(skippedDepth > 0 || complete) return true;
+        if(selectedDepth > 0) return dom.key(key);
+        memberNode = paths.child(path.back().node, key);
+        if(path.size() == 1) rootMember = memberNode;
+        return memberNode < 0 || dom.key(key);
+    }
+
+    void begin(bool array) {
+        long node = next();
+        if(node == SKIP) {
+            skippedDepth++;
+            return;
+        }
+        place();
+        if(node == BUILD) selectedDepth++;
+        else path.push_back({size_t(node), array, 0, 0});
+        if(array) dom.beginArray();
+        else dom.beginObject();
+    }
+
+    void end(bool array) {
+        if(skippedDepth > 0) {
+            skippedDepth--;
+            return;
+        }
+        if(selectedDepth > 0) selectedDepth--;
+        else path.pop_back();
+        if(array) dom.endArray();
+        else dom.endObject();
+        memberEnded();
+    }
+
+    void beginObject() { begin(false); }
+    void beginArray() { begin(true); }
+    void endObject() { end(false); }
+    void endArray() { end(true); }
+
+    // Scalars are built only when selected themselves, a path going deeper can't continue in them
+    bool take() {
+        bool build = next() == BUILD;
+        if(build) place();
+        memberEnded();
+        return build;
+    }
+
+    void value(std::string&& value) { if(take()) dom.value(std::move(value)); }
+    void value(long long value) { if(take()) dom.value(value); }
+    void value(double value) { if(take()) dom.value(value); }
+    void value(bool value) { if(take()) dom.value(value); }
+    void null() { if(take()) dom.null(); }
+};
+
+// Same as parseText, but stops once the builder has everything it needs
+template<typename Source> static int parseProjected(Source& source, projectionBuilder& builder, json::exitCode& code, parserScratch& scratch) {
+    textParser<projectionBuilder> parser(builder, code, scratch);
+    char ch;
+    int result = -1;
+    while(result < 0 && source.get(ch)) {
+        result = parser.step(ch);
+        if(result < 0 && builder.complete && !builder.paths.checkRest) {
+            constructExitCode(code, json::PARSE_SUCCESS, 0, 0);
+            return 1;
+        }
+    }
+    if(result < 0) result = parser.finish();
+    if(result == 0) source.locate(code);
+    return result;
+}
+
+int json::parse(std::istream &stream, object& object, exitCode& code, const projection& paths) {
+    parserScratch scratch;
+    streamSource source(stream);
+    projectionBuilder builder(object, paths);
+    return parseProjected(source, builder, code, scratch);
+}
+
+int json::parse(std::string_view text, object& object, exitCode& code, const projection& paths) {
+    thread_local parserScratch scratch;
+    bufferSource source{text.data(), text.data() + text.size()};
+    projectionBuilder builder(object, paths);
+    return parseProjected(source, builder, code, scratch);
+}
@@ -0,0 +1,154 @@
+#include "parkinson.hpp"
+
+// --- Iterative destruction ---
+// Children are moved out of the structure into the stacks below and destroyed one by one.
+// Before a child is destroyed its own children are moved to the stacks as well, 
+// so destructor of every structure finds only plain values inside and never recurses 
+
+struct teardown {
+    std::vector<std::unique_ptr<json::object>> objects;
+    std::vector<std::unique_ptr<json::array>> arrays;
+    std::vector<std::shared_ptr<const json::object>> sharedObjects;
+    std::vector<std::shared_ptr<const json::array>> sharedArrays;
+
+    void take(json::value& value) {
+        if(value.type == json::JSON_OBJECT) {
+            if(auto ptr = std::get_if<std::unique_ptr<json::object>>(&value.value)) {
+                if(*ptr) objects.push_back(std::move(*ptr));
+            } else if(auto shared = std::get_if<std::shared_ptr<const json::object>>(&value.value)) {
+                if(*shared) sharedObjects.push_back(std::move(*shared));
+            }
+        } else if(value.type == json::JSON_ARRAY) {
+            if(auto ptr = std::get_if<std::unique_ptr<json::array>>(&value.value)) {
+                if(*ptr) arrays.push_back(std::move(*ptr));
+            } else if(auto shared = std::get_if<std::shared_ptr<const json::array>>(&value.value)) {
+                if(*shared) sharedArrays.push_back(std::move(*shared));
+            }
+        }
+    }
+    void drain(json::shareState& share) {
+        if(share.objectSnapshot) sharedObjects.push_back(std::move(share.objectSnapshot));
+        if(share.arraySnapshot) sharedArrays.push_back(std::move(share.arraySnapshot));
+        if(share.objectOrigin) sharedObjects.push_back(std::move(share.objectOrigin));
+        if(share.arrayOrigin) sharedArrays.push_back(std::move(share.arrayOrigin));
+        auto takeCopy = [this](json::shareState::borrowedChild& child) {
+            if(child.objectCopy) objects.push_back(std::move(child.objectCopy));
+            if(child.arrayCopy) arrays.push_back(std::move(child.arrayCopy));
+        };
+        for(auto& [origin, child]: share.borrowed) takeCopy(child);
+        for(auto& child: share.orphans) takeCopy(child);
+    }
+    void drain(json::object& object) {
+        for(auto& [key, val]: object.data) take(val);
+        if(object.share) drain(*object.share);
+    }
+    void drain(json::array& array) {
+        for(auto& val: array.data) take(val);
+        if(array.share) drain(*array.share);
+    }
+    void run() {
+        while(!objects.empty() || !arrays.empty() || !sharedObjects.empty() || !sharedArrays.empty()) {
+            if(!objects.empty()) {
+                std::unique_ptr<json::object> object = std::move(objects.back());
+                objects.pop_back();
+                drain(*object);
+            } else if(!arrays.empty()) {
+                std::unique_ptr<json::array> array = std::move(arrays.back());
+                arrays.pop_back();
+                drain(*array);
+            } else if(!sharedObjects.empty()) {
+                // Shared structure is destroyed only with its last reference, 
+                // then nobody else can see it and its children can be taken 
+                std::shared_ptr<const json::object> object = std::move(sharedObjects.back());
+                sharedObjects.pop_back();
+                if(object.use_count() == 1) drain(const_cast<json::object&>(*object));
+            } else {
+                std::shared_ptr<const json::array> array = std::move(sharedArrays.back());
+                sharedArrays.pop_back();
+                if(array.use_count() == 1) drain(const_cast<json::array&>(*array));
+            }
+        }
+    }
+};
+
+json::object::~object() {
+    teardown t;
+    t.drain(*this);
+    t.run();
+}
+
+json::array::~array() {
+    teardown t;
+    t.drain(*this);
+    t.run();
+}
+
+// --- Deferred destruction ---
+
+json::reclaimer::reclaimer() {
+    thread = std::thread([this]() { run(); });
+}
+
+json::reclaimer::~reclaimer() {
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        stop = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void json::reclaimer::retire(std::unique_ptr<json::object> object) {
+    if(!object) return;
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        objects.push_back(std::move(object));
+        retired++;
+    }
+    wake.notify_one();
+}
+
+void json::reclaimer::retire(std::unique_ptr<json::array> array) {
+    if(!array) return;
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        arrays.push_back(std::move(array));
+        retired++;
+    }
+    wake.notify_one();
+}
+
+void json::reclaimer::retire(json::object&& object) {
+    retire(std::make_unique<json::object>(std::move(object)));
+}
+
+void json::reclaimer::flush() {
+    std::unique_lock<std::mutex> lk(lock);
+    unsigned long target = retired;
+    done.wait(lk, [&]() { return destroyed >= target; });
+}
+
+void json::reclaimer::run() {
+    std::vector<std::unique_ptr<json::object>> batchObjects;
+    std::vector<std::unique_ptr<json::array>> batchArrays;
+    std::unique_lock<std::mutex> lk(lock);
+    while(true) {
+        wake.wait(lk, [&]() { return stop || !objects.empty() || !arrays.empty(); });
+        if(objects.empty() && arrays.empty()) return;
+        // Taking everything retired so far as one batch 
+        batchObjects.swap(objects);
+        batchArrays.swap(arrays);
+        unsigned long count = batchObjects.size() + batchArrays.size();
+        lk.unlock();
+        batchObjects.clear();
+        batchArrays.clear();
+        lk.lock();
+        destroyed += count;
+        done.notify_all();
+    }
+}
+
+json::reclaimer& json::reclaimer::shared() {
+    static reclaimer instance;
+    return instance;
+}
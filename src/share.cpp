@@ -0,0 +1,174 @@
+#include "parkinson.hpp"
+
+// --- Shared structures (COPY_SHARED) ---
+// Shared structure is held by std::shared_ptr<const T> and is never changed.
+// All children of a shared structure are shared as well, so copy of a shared
+// structure only copies its own values and shares everything below them.
+// Shared structures have no parents, they can be a child of many structures at once.
+// Structures of the original are never shared themselves, pointers to them stay private to the original:
+// copies get frozen snapshots of them, kept in shareState until the structure changes
+
+const json::object* json::value::getObject() const {
+    if(auto owned = std::get_if<std::unique_ptr<json::object>>(&value)) return owned->get();
+    if(auto shared = std::get_if<std::shared_ptr<const json::object>>(&value)) return shared->get();
+    return nullptr;
+}
+
+const json::array* json::value::getArray() const {
+    if(auto owned = std::get_if<std::unique_ptr<json::array>>(&value)) return owned->get();
+    if(auto shared = std::get_if<std::shared_ptr<const json::array>>(&value)) return shared->get();
+    return nullptr;
+}
+
+// See object.cpp
+json::value copyScalar(const json::value& val);
+
+std::shared_ptr<const json::object> snapshot(json::object& object);
+std::shared_ptr<const json::array> snapshot(json::array& array);
+
+// Value of the snapshot: owned children are replaced with their own snapshots, shared ones are shared again
+static json::value snapshotValue(json::value& val) {
+    if(auto owned = std::get_if<std::unique_ptr<json::object>>(&val.value)) return json::value{ snapshot(**owned), json::JSON_OBJECT };
+    if(auto owned = std::get_if<std::unique_ptr<json::array>>(&val.value)) return json::value{ snapshot(**owned), json::JSON_ARRAY };
+    if(auto shared = std::get_if<std::shared_ptr<const json::object>>(&val.value)) return json::value{ *shared, json::JSON_OBJECT };
+    if(auto shared = std::get_if<std::shared_ptr<const json::array>>(&val.value)) return json::value{ *shared, json::JSON_ARRAY };
+    return copyScalar(val);
+}
+
+// Snapshot of a structure is made together with the snapshots of all of its children,
+// so a structure without one has no parents with one and dropping them stops there (see invalidate)
+std::shared_ptr<const json::object> snapshot(json::object& object) {
+    if(object.share && object.share->objectSnapshot) return object.share->objectSnapshot;
+    auto frozen = std::make_shared<json::object>();
+    // Shared structures are read by many documents at once, nothing is cached in them
+    frozen->outputDirty = false;
+    frozen->data.reserve(object.data.size());
+    for(auto& [key, val]: object.data) frozen->data.emplace(key, snapshotValue(val));
+    if(!object.share) object.share = std::make_unique<json::shareState>();
+    object.share->objectSnapshot = frozen;
+    return frozen;
+}
+
+std::shared_ptr<const json::array> snapshot(json::array& array) {
+    if(array.share && array.share->arraySnapshot) return array.share->arraySnapshot;
+    auto frozen = std::make_shared<json::array>();
+    frozen->outputDirty = false;
+    frozen->data.reserve(array.data.size());
+    for(auto& val: array.data) frozen->data.push_back(snapshotValue(val));
+    if(!array.share) array.share = std::make_unique<json::shareState>();
+    array.share->arraySnapshot = frozen;
+    return frozen;
+}
+
+static json::shareState& holderState(json::object* parentObject, json::array* parentArray) {
+    std::unique_ptr<json::shareState>& share = parentObject != nullptr ? parentObject->share : parentArray->share;
+    if(!share) share = std::make_unique<json::shareState>();
+    return *share;
+}
+
+// Getting the object in the slot for changing. Shared object is copied one level deep, children of the copy
+// stay shared. Copy is kept by the parent aside, the parent holds the shared object until the copy changes (see unshare),
+// so reading through the copy doesn't stop the document from sharing
+json::object* ownObject(json::value& slot, json::object* parentObject, json::array* parentArray, const std::string& key, size_t index) {
+    if(auto owned = std::get_if<std::unique_ptr<json::object>>(&slot.value)) return owned->get();
+    auto& shared = std::get<std::shared_ptr<const json::object>>(slot.value);
+    json::shareState& holder = holderState(parentObject, parentArray);
+    auto found = holder.borrowed.find(shared.get());
+    if(found != holder.borrowed.end()) return found->second.objectCopy.get();
+    auto copy = json::object::copy(*shared);
+    copy->addParentObject(parentObject);
+    copy->addParentArray(parentArray);
+    // Copy has the same data, so output cached by the parents is still correct
+    copy->outputDirty = false;
+    copy->share = std::make_unique<json::shareState>();
+    copy->share->objectOrigin = shared;
+    json::object* ptr = copy.get();
+    holder.borrowed.emplace(shared.get(), json::shareState::borrowedChild{ key, index, std::move(copy), nullptr });
+    return ptr;
+}
+
+json::array* ownArray(json::value& slot, json::object* parentObject, json::array* parentArray, const std::string& key, size_t index) {
+    if(auto owned = std::get_if<std::unique_ptr<json::array>>(&slot.value)) return owned->get();
+    auto& shared = std::get<std::shared_ptr<const json::array>>(slot.value);
+    json::shareState& holder = holderState(parentObject, parentArray);
+    auto found = holder.borrowed.find(shared.get());
+    if(found != holder.borrowed.end()) return found->second.arrayCopy.get();
+    auto copy = json::array::copy(*shared);
+    copy->addParentObject(parentObject);
+    copy->addParentArray(parentArray);
+    copy->outputDirty = false;
+    copy->share = std::make_unique<json::shareState>();
+    copy->share->arrayOrigin = shared;
+    json::array* ptr = copy.get();
+    holder.borrowed.emplace(shared.get(), json::shareState::borrowedChild{ key, index, nullptr, std::move(copy) });
+    return ptr;
+}
+
+// Slot of the parent still holding the shared structure the copy was made from
+static json::value* originSlot(json::object* parentObject, json::array* parentArray, const json::shareState::borrowedChild& child, const void* origin) {
+    auto holds = [origin](const json::value& val) {
+        return val.getObject() == origin || static_cast<const void*>(val.getArray()) == origin;
+    };
+    if(parentObject != nullptr) {
+        auto it = parentObject->data.find(child.key);
+        return it != parentObject->data.end() && holds(it->second) ? &it->second : nullptr;
+    }
+    // Elements may have moved since the copy was made
+    std::vector<json::value>& data = parentArray->data;
+    if(child.index < data.size() && holds(data[child.index])) return &data[child.index];
+    for(auto& val: data) {
+        if(holds(val)) return &val;
+    }
+    return nullptr;
+}
+
+// Putting the changed copy in place of the shared structure it was made from
+static void placeCopy(json::object* parentObject, json::array* parentArray, const void* origin) {
+    json::shareState& holder = holderState(parentObject, parentArray);
+    auto found = holder.borrowed.find(origin);
+    if(found == holder.borrowed.end()) return;
+    json::shareState::borrowedChild& child = found->second;
+    json::value* slot = originSlot(parentObject, parentArray, child, origin);
+    if(slot == nullptr) {
+        // Shared structure was replaced in the meantime, the copy stays apart from the document
+        holder.orphans.push_back(std::move(child));
+    } else if(child.objectCopy) {
+        slot->value = std::move(child.objectCopy);
+    } else {
+        slot->value = std::move(child.arrayCopy);
+    }
+    holder.borrowed.erase(found);
+}
+
+// Called for every structure with shareState on the way up from a change (see object::invalidate).
+// Snapshot of the structure is outdated now, copy made by get(key, object*&) takes the place of the shared structure
+void unshare(json::object& object) {
+    json::shareState& share = *object.share;
+    share.objectSnapshot.reset();
+    if(!share.objectOrigin) return;
+    placeCopy(object.parent, object.parentArray, share.objectOrigin.get());
+    share.objectOrigin.reset();
+}
+
+void unshare(json::array& array) {
+    json::shareState& share = *array.share;
+    share.arraySnapshot.reset();
+    if(!share.arrayOrigin) return;
+    placeCopy(array.parentObject, array.parentArray, share.arrayOrigin.get());
+    share.arrayOrigin.reset();
+}
+
+std::unique_ptr<json::object> json::object::copy(json::object &original, json::copyMode mode) {
+    if(mode != COPY_SHARED) return copy(static_cast<const json::object&>(original));
+    // Copy of the snapshot copies only its values and shares everything below them
+    std::unique_ptr<json::object> object = copy(*snapshot(original));
+    object->cacheOutput = original.cacheOutput;
+    return object;
+}
+
+std::unique_ptr<json::array> json::array::copy(json::array &original, json::copyMode mode) {
+    if(mode != COPY_SHARED) return copy(static_cast<const json::array&>(original));
+    std::unique_ptr<json::array> array = copy(*snapshot(original));
+    array->cacheOutput = original.cacheOutput;
+    return array;
+}
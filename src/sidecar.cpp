@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// Sidecar file is a header followed by the containers and the entries of sidecar_index.
+// Containers are numbered in the order they are opened, so the root object is the first one.
+// Size and modification time of the text are kept in the header, the index of a changed file isn't loaded
+struct sidecarHeader {
+    char magic[8];
+    // Written as 0x0102030405060708, so files of the other byte order are rejected
+    uint64_t byteOrder;
+    uint64_t textSize;
+    uint64_t textModified;
+    uint64_t containerCount;
+    uint64_t entryCount;
+};
+
+static const char SIDECAR_MAGIC[8] = {'P', 'K', 'S', 'I', 'D', 'E', '0', '1'};
+static const uint64_t SIDECAR_BYTE_ORDER = 0x0102030405060708ULL;
+static const uint64_t NO_OFFSET = json::sidecar_index::NO_OFFSET;
+
+static uint64_t modifiedTime(const struct stat& info) {
+    return uint64_t(info.st_mtim.tv_sec) * 1000000000ULL + uint64_t(info.st_mtim.tv_nsec);
+}
+
+// Mapping the whole file read-only. Empty files have nothing to map, their storage stays empty
+static bool mapFile(const std::string& path, std::shared_ptr<const void>& storage, std::string_view& data, struct stat& info) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    data = std::string_view();
+    storage.reset();
+    if(size == 0) {
+        close(fd);
+        return true;
+    }
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // Mapping stays valid after the file is closed
+    close(fd);
+    if(address == MAP_FAILED) return false;
+    storage = std::shared_ptr<const void>(address, [size](const void* address) {
+        munmap(const_cast<void*>(address), size);
+    });
+    data = std::string_view(static_cast<const char*>(address), size);
+    return true;
+}
+
+// FNV-1a, the same in every build, so the index can be read by other programs
+static uint64_t hashKey(std::string_view key) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned char ch: key) {
+        hash ^= ch;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Text of the key starting with the quote at the offset, unescaped only if it has to be
+static bool readKey(std::string_view text, uint64_t quote, std::string& buffer, std::string_view& key) {
+    bool escaped = false;
+    bool prevBS = false;
+    for(size_t at = quote + 1; at < text.size(); at++) {
+        if(text[at] == '"' && !prevBS) {
+            key = text.substr(quote + 1, at - quote - 1);
+            if(!escaped) return true;
+            std::string raw(key);
+            buffer.clear();
+            if(!processString(raw, buffer)) return false;
+            key = buffer;
+            return true;
+        }
+        prevBS = text[at] == '\\' && !prevBS;
+        escaped |= text[at] == '\\';
+    }
+    return false;
+}
+
+// --- Building ---
+// Structural positions of the validated text are read in windows, only the containers of the indexed levels
+// keep their members. Members of a container are collected until it closes, so they stay together in the file
+
+struct sidecarBuilder {
+    struct frame {
+        bool object;
+        uint64_t container;
+        uint64_t start;
+        // Quote of the key of the member being read
+        uint64_t key = NO_OFFSET;
+        std::vector<json::sidecar_index::entry> members;
+    };
+    std::string_view text;
+    unsigned levels;
+    std::vector<json::sidecar_index::container> containers;
+    std::vector<json::sidecar_index::entry> entries;
+    std::vector<frame> stack;
+    std::string buffer;
+    uint64_t stringStart = NO_OFFSET;
+    // Depth inside of the containers below the indexed levels, and the start of the outermost of them
+    uint64_t skipped = 0;
+    uint64_t skippedStart = 0;
+    // First byte after the last position
+    uint64_t last = 0;
+    bool done = false;
+    bool failed = false;
+    // Byte where the building failed
+    uint64_t failedAt = 0;
+
+    void add(uint64_t start, uint64_t end, uint64_t child) {
+        frame& top = stack.back();
+        json::sidecar_index::entry member{NO_OFFSET, 0, start, end, child};
+        if(top.object) {
+            std::string_view key;
+            if(!readKey(text, top.key, buffer, key)) {
+                failed = true;
+                failedAt = top.key;
+                return;
+            }
+            member.key = top.key;
+            member.hash = hashKey(key);
+            top.key = NO_OFFSET;
+        }
+        top.members.push_back(member);
+    }
+
+    void close(uint64_t end) {
+        frame& top = stack.back();
+        if(top.object) {
+            std::stable_sort(top.members.begin(), top.members.end(), [](auto& a, auto& b) { return a.hash < b.hash; });
+        }
+        containers[top.container] = {entries.size(), top.members.size(), top.start, end};
+        entries.insert(entries.end(), top.members.begin(), top.members.end());
+        uint64_t start = top.start;
+        uint64_t container = top.container;
+        stack.pop_back();
+        if(stack.empty()) done = true;
+        else add(start, end, container);
+    }
+
+    void position(uint64_t at) {
+        char ch = text[at];
+        if(ch == '"') {
+            if(stringStart == NO_OFFSET) {
+                stringStart = at;
+                return;
+            }
+            uint64_t start = stringStart;
+            stringStart = NO_OFFSET;
+            last = at + 1;
+            if(skipped > 0) return;
+            if(stack.back().object && stack.back().key == NO_OFFSET) stack.back().key = start;
+            else add(start, at + 1, NO_OFFSET);
+            return;
+        }
+        if(ch == '{' || ch == '[') {
+            if(skipped > 0 || stack.size() >= levels) {
+                if(skipped++ == 0) skippedStart = at;
+            } else {
+                stack.push_back({ch == '{', containers.size(), at, NO_OFFSET, {}});
+                containers.emplace_back();
+            }
+        } else if(skipped > 0) {
+            if((ch == '}' || ch == ']') && --skipped == 0) add(skippedStart, at + 1, NO_OFFSET);
+        } else if(ch != ':') {
+            // Numbers, booleans and null are what is left between the positions
+            uint64_t from = last;
+            while(from < at && isWhiteSpace(text[from])) from++;
+            uint64_t to = at;
+            while(to > from && isWhiteSpace(text[to - 1])) to--;
+            if(from < to) add(from, to, NO_OFFSET);
+            if(ch != ',') close(at + 1);
+        }
+        last = at + 1;
+    }
+};
+
+int json::buildSidecar(const std::string& path, const std::string& indexPath, json::exitCode& code, unsigned levels) {
+    std::shared_ptr<const void> storage;
+    std::string_view text;
+    struct stat info;
+    if(!mapFile(path, storage, text, info)) {
+        constructExitCode(code, PARSE_ERR_IO, 0, 0);
+        return 0;
+    }
+    if(!json::validate(text, code)) return 0;
+
+    sidecarBuilder builder;
+    builder.text = text;
+    builder.levels = std::max(levels, 1u);
+    structuralScanner scanner;
+    std::vector<uint32_t> positions;
+    const size_t WINDOW = 1 << 20;
+    for(size_t from = 0; from < text.size() && !builder.done && !builder.failed; from += WINDOW) {
+        positions.clear();
+        scanner.scan(text, from, std::min(text.size(), from + WINDOW), positions);
+        for(uint32_t position: positions) {
+            builder.position(from + position);
+            if(builder.done || builder.failed) break;
+        }
+    }
+    // Validated text always gets its index, the scan and the validation disagree otherwise
+    if(!builder.done || builder.failed) {
+        constructExitCode(code, PARSE_UNHANDLED_ERROR, builder.failed ? builder.failedAt + 1 : text.size());
+        locateText(code, text.data(), code.offset);
+        return 0;
+    }
+
+    sidecarHeader header;
+    std::memcpy(header.magic, SIDECAR_MAGIC, sizeof(header.magic));
+    header.byteOrder = SIDECAR_BYTE_ORDER;
+    header.textSize = text.size();
+    header.textModified = modifiedTime(info);
+    header.containerCount = builder.containers.size();
+    header.entryCount = builder.entries.size();
+    std::ofstream out(indexPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(builder.containers.data()), builder.containers.size() * sizeof(sidecar_index::container));
+    out.write(reinterpret_cast<const char*>(builder.entries.data()), builder.entries.size() * sizeof(sidecar_index::entry));
+    out.close();
+    if(!out) {
+        constructExitCode(code, PARSE_ERR_IO, 0, 0);
+        return 0;
+    }
+    constructExitCode(code, PARSE_SUCCESS, 0, 0);
+    return 1;
+}
+
+// --- Loading ---
+
+// Checking that every offset and index points inside of the text and the index, so lookups can't read outside of the mappings
+static bool verifySidecar(const json::sidecar_index& index) {
+    uint64_t size = index.text.size();
+    for(size_t i = 0; i < index.containerCount; i++) {
+        const json::sidecar_index::container& container = index.containers[i];
+        if(container.first > index.entryCount || container.count > index.entryCount - container.first) return false;
+        if(container.start >= container.end || container.end > size) return false;
+        char open = index.text[container.start];
+        if((open != '{' && open != '[') || index.text[container.end - 1] != (open == '{' ? '}' : ']')) return false;
+    }
+    for(size_t i = 0; i < index.entryCount; i++) {
+        const json::sidecar_index::entry& entry = index.entries[i];
+        if(entry.start >= entry.end || entry.end > size) return false;
+        if(entry.key != NO_OFFSET && (entry.key >= size || index.text[entry.key] != '"')) return false;
+        if(entry.child != NO_OFFSET && entry.child >= index.containerCount) return false;
+    }
+    return true;
+}
+
+bool json::loadSidecar(const std::string& path, const std::string& indexPath, json::sidecar_index& index, bool verify) {
+    json::sidecar_index loaded;
+    std::string_view indexData;
+    struct stat textInfo, indexInfo;
+    if(!mapFile(path, loaded.textStorage, loaded.text, textInfo)) return false;
+    if(!mapFile(indexPath, loaded.indexStorage, indexData, indexInfo) || indexData.size() < sizeof(sidecarHeader)) return false;
+
+    sidecarHeader header;
+    std::memcpy(&header, indexData.data(), sizeof(header));
+    if(std::memcmp(header.magic, SIDECAR_MAGIC, sizeof(header.magic)) != 0) return false;
+    if(header.byteOrder != SIDECAR_BYTE_ORDER) return false;
+    if(header.textSize != loaded.text.size() || header.textModified != modifiedTime(textInfo)) return false;
+    size_t containerBytes = (indexData.size() - sizeof(header)) / sizeof(sidecar_index::container);
+    if(header.containerCount == 0 || header.containerCount > containerBytes) return false;
+    size_t rest = indexData.size() - sizeof(header) - header.containerCount * sizeof(sidecar_index::container);
+    if(rest != header.entryCount * sizeof(sidecar_index::entry)) return false;
+
+    loaded.containers = reinterpret_cast<const sidecar_index::container*>(indexData.data() + sizeof(header));
+    loaded.containerCount = header.containerCount;
+    loaded.entries = reinterpret_cast<const sidecar_index::entry*>(loaded.containers + header.containerCount);
+    loaded.entryCount = header.entryCount;
+    if(verify && !verifySidecar(loaded)) return false;
+    index = std::move(loaded);
+    return true;
+}
+
+// --- Lookup ---
+
+// Array index of the pointer token: digits without leading zeros
+static bool readIndex(std::string_view token, size_t& index) {
+    if(token.empty() || (token.size() > 1 && token[0] == '0')) return false;
+    auto result = std::from_chars(token.data(), token.data() + token.size(), index);
+    return result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+static const json::sidecar_index::entry* findMember(const json::sidecar_index& index, const json::sidecar_index::container& container, const std::string& token) {
+    const json::sidecar_index::entry* first = index.entries + container.first;
+    const json::sidecar_index::entry* last = first + container.count;
+    if(index.text[container.start] == '[') {
+        size_t at;
+        return readIndex(token, at) && at < container.count ? first + at : nullptr;
+    }
+    uint64_t hash = hashKey(token);
+    auto found = std::lower_bound(first, last, hash, [](const json::sidecar_index::entry& entry, uint64_t hash) { return entry.hash < hash; });
+    std::string buffer;
+    for(; found != last && found->hash == hash; found++) {
+        std::string_view key;
+        if(readKey(index.text, found->key, buffer, key) && key == token) return found;
+    }
+    return nullptr;
+}
+
+// Parsing any value as the member of an object, the value is taken out of it then
+static bool parseValue(std::string_view text, json::value& out) {
+    json::object holder;
+    json::exitCode code;
+    parserScratch scratch;
+    domBuilder builder(holder);
+    textParser<domBuilder> parser(builder, code, scratch);
+    for(char ch: std::string_view("{\"\":")) parser.step(ch);
+    const char* at = text.data();
+    if(parser.feed(at, text.data() + text.size()) >= 0 || parser.step('}') != 1) return false;
+    out = std::move(holder.data.begin()->second);
+    detachValue(out);
+    return true;
+}
+
+bool json::sidecar_index::get(std::string_view pointer, json::value& out) const {
+    std::vector<std::string> tokens;
+    if(containerCount == 0 || !splitPointer(pointer, tokens)) return false;
+    uint64_t start = containers[0].start;
+    uint64_t end = containers[0].end;
+    uint64_t container = 0;
+    size_t used = 0;
+    for(; used < tokens.size() && container != NO_OFFSET; used++) {
+        const entry* member = findMember(*this, containers[container], tokens[used]);
+        if(member == nullptr) return false;
+        start = member->start;
+        end = member->end;
+        container = member->child;
+    }
+    json::value value;
+    if(!parseValue(text.substr(start, end - start), value)) return false;
+    if(used == tokens.size()) {
+        out = std::move(value);
+        return true;
+    }
+
+    // Rest of the pointer is below the indexed levels
+    json::value* current = &value;
+    for(; used < tokens.size(); used++) {
+        size_t at;
+        if(auto object = std::get_if<std::unique_ptr<json::object>>(&current->value)) {
+            auto found = (*object)->data.find(tokens[used]);
+            if(found == (*object)->data.end()) return false;
+            current = &found->second;
+        } else if(auto array = std::get_if<std::unique_ptr<json::array>>(&current->value)) {
+            if(!readIndex(tokens[used], at) || at >= (*array)->data.size()) return false;
+            current = &(*array)->data[at];
+        } else return false;
+    }
+    out = std::move(*current);
+    detachValue(out);
+    return true;
+}
@@ -0,0 +1,145 @@
+#include <cstring>
+#include <fcntl.h>
+#include <ostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "parkinson.hpp"
+
+// Snapshot is the tape of the frozen document (see frozen.cpp) written after a header.
+// Tape holds only indexes and offsets, so the mapped file is used as it is
+struct snapshotHeader {
+    char magic[8];
+    // Written as 0x0102030405060708, so files of the other byte order are rejected
+    uint64_t byteOrder;
+    uint64_t tapeWords;
+    uint64_t stringBytes;
+};
+
+static const char SNAPSHOT_MAGIC[8] = {'P', 'K', 'S', 'N', 'A', 'P', '0', '1'};
+static const uint64_t SNAPSHOT_BYTE_ORDER = 0x0102030405060708ULL;
+static const uint64_t PAYLOAD_MASK = (uint64_t(1) << 56) - 1;
+
+static bool verifyString(uint64_t word, const char* strings, size_t bytes) {
+    uint64_t offset = word & PAYLOAD_MASK;
+    uint32_t length;
+    if(char(word >> 56) != '"' || offset > bytes || bytes - offset < sizeof(length)) return false;
+    std::memcpy(&length, strings + offset, sizeof(length));
+    return bytes - offset - sizeof(length) >= length;
+}
+
+// Checking that the tape is a well-formed document and every index and offset points inside of the snapshot,
+// so the getters can't read outside of the mapping
+static bool verifyTape(const uint64_t* tape, size_t words, const char* strings, size_t bytes) {
+    struct level {
+        size_t end;
+        bool object;
+        uint64_t count;
+    };
+    std::vector<level> open;
+    if(words < 2 || char(tape[0] >> 56) != '{' || (tape[0] & PAYLOAD_MASK) != words - 1) return false;
+    size_t i = 0;
+    while(i < words) {
+        if(!open.empty() && i == open.back().end) {
+            char end = open.back().object ? '}' : ']';
+            if(char(tape[i] >> 56) != end || (tape[i] & PAYLOAD_MASK) != open.back().count) return false;
+            open.pop_back();
+            i++;
+            if(open.empty()) return i == words;
+            continue;
+        }
+        size_t limit = open.empty() ? words : open.back().end;
+        if(!open.empty()) {
+            open.back().count++;
+            // Members of objects start with the key 
+            if(open.back().object) {
+                if(!verifyString(tape[i], strings, bytes) || ++i >= limit) return false;
+            }
+        }
+        char tag = char(tape[i] >> 56);
+        uint64_t payload = tape[i] & PAYLOAD_MASK;
+        switch(tag) {
+            case '{':
+            case '[':
+                if(payload <= i || payload >= limit) return false;
+                open.push_back({payload, tag == '{', 0});
+                i++;
+                break;
+            case 'l':
+            case 'd':
+                // Next word is the raw value
+                if(i + 2 > limit) return false;
+                i += 2;
+                break;
+            case '"':
+                if(!verifyString(tape[i], strings, bytes)) return false;
+                i++;
+                break;
+            case 't':
+            case 'f':
+            case 'n':
+                i++;
+                break;
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool json::saveSnapshot(std::ostream &stream, const json::frozen_document& document) {
+    json::frozen_document empty;
+    const json::frozen_document* source = &document;
+    // Document that was never filled is saved as an empty object
+    if(document.tape == nullptr) {
+        json::object object;
+        empty = json::frozen_document(object);
+        source = &empty;
+    }
+    snapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.tapeWords = source->tapeWords;
+    header.stringBytes = source->stringBytes;
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(source->tape), source->tapeWords * sizeof(uint64_t));
+    stream.write(source->strings, source->stringBytes);
+    return stream.good();
+}
+
+bool json::loadSnapshot(const std::string& path, json::frozen_document& document, bool verify) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(snapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // Mapping stays valid after the file is closed
+    close(fd);
+    if(address == MAP_FAILED) return false;
+    std::shared_ptr<const void> storage(address, [size](const void* address) {
+        munmap(const_cast<void*>(address), size);
+    });
+
+    snapshotHeader header;
+    std::memcpy(&header, address, sizeof(header));
+    if(std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) return false;
+    if(header.byteOrder != SNAPSHOT_BYTE_ORDER) return false;
+    size_t available = (size - sizeof(header)) / sizeof(uint64_t);
+    if(header.tapeWords > available) return false;
+    if(header.stringBytes != size - sizeof(header) - header.tapeWords * sizeof(uint64_t)) return false;
+
+    const uint64_t* tape = reinterpret_cast<const uint64_t*>(static_cast<const char*>(address) + sizeof(header));
+    const char* strings = reinterpret_cast<const char*>(tape + header.tapeWords);
+    if(verify && !verifyTape(tape, header.tapeWords, strings, header.stringBytes)) return false;
+
+    document.storage = std::move(storage);
+    document.tape = tape;
+    document.tapeWords = header.tapeWords;
+    document.strings = strings;
+    document.stringBytes = header.stringBytes;
+    return true;
+}
@@ -1,10 +1,38 @@
 #include "parkinson.hpp"
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
 #include <istream>
 #include <ostream>
+#include <set>
 #include <sstream>
 #include <iostream>
 #include <type_traits>
+#include <unistd.h>
+
+// Counting the allocations of the program, for the tests that check that nothing is allocated
+static std::atomic<size_t> allocations = 0;
+// Counting the frees, for the tests that check that memory is given back
+static std::atomic<size_t> deallocations = 0;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    if(memory) deallocations.fetch_add(1, std::memory_order_relaxed);
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    if(memory) deallocations.fetch_add(1, std::memory_order_relaxed);
+    std::free(memory);
+}
 
 template<typename T> bool runTestObjectGetters(const char* json, const char* name, const std::string& key, const T& expected) { 
     std::istringstream in(json);
@@ -494,6 +522,1376 @@ bool outputTest(const char* json, const char* name) {
     return ok;
 }
 
+bool runTestParallelOutput(const char* name) {
+    json::object root;
+    json::array& records = root.emplaceArray("records");
+    for(long long i = 0; i < 2000; i++) {
+        json::object& rec = records.pushObject();
+        rec.setValue("id", i);
+        rec.setValue("score", i * 0.25);
+        rec.setValue("name", "record");
+        json::array& tags = rec.emplaceArray("tags");
+        tags.push(true);
+        tags.pushNull();
+    }
+    root.setValue("count", 2000LL);
+    root.emplaceObject("empty");
+
+    std::ostringstream serial;
+    json::outputObject(serial, root);
+
+    json::threadPool pool(4);
+    json::outputConfig config;
+    config.pool = &pool;
+    config.parallelThreshold = 16;
+    config.chunkNodes = 64;
+    std::ostringstream parallel;
+    json::outputObject(parallel, root, config);
+
+    bool ok = serial.str() == parallel.str();
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestOutputCache(const char* name) {
+    json::object root;
+    json::object& config = root.emplaceObject("config");
+    config.setValue("port", 8080LL);
+    json::array& hosts = config.emplaceArray("hosts");
+    hosts.push("a");
+    hosts.push("b");
+    json::object& limits = root.emplaceObject("limits");
+    limits.setValue("rps", 100LL);
+    root.setOutputCache(true);
+
+    std::ostringstream first;
+    json::outputObject(first, root);
+    bool ok = root.outputCacheIndent == 0 && limits.outputCacheIndent == 1;
+
+    // Changing a leaf drops cache of the path up to the root only 
+    hosts.setValue(1, "c");
+    ok &= hosts.outputCacheIndent == -1 && config.outputCacheIndent == -1 && root.outputCacheIndent == -1;
+    ok &= limits.outputCacheIndent == 1;
+
+    std::ostringstream cached;
+    json::outputObject(cached, root);
+    root.setOutputCache(false);
+    std::ostringstream plain;
+    json::outputObject(plain, root);
+    ok &= cached.str() == plain.str() && cached.str() != first.str();
+
+    // Output without the caches only reads the document, so threads can write it out at once 
+    json::object parsed;
+    json::exitCode code;
+    ok &= json::parse(std::string_view(R"({"a": {"b": [1, 2]}})"), parsed, code) == 1;
+    std::ostringstream outputs[2];
+    std::thread other([&] { json::outputObject(outputs[1], parsed); });
+    json::outputObject(outputs[0], parsed);
+    other.join();
+    ok &= outputs[0].str() == outputs[1].str() && parsed.outputDirty;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestCanonicalOutput(const char* name) {
+    json::object object;
+    object.setValue("b", 1e21);
+    object.setValue("a", 1e20);
+    object.setValue("\xEF\xAC\xB3", 0.000001);   // U+FB33
+    object.setValue("\xF0\x9F\x98\x80", 1e-7);  // U+1F600
+    object.setValue("\xE2\x82\xAC", -0.0);       // U+20AC
+    object.setValue("1", 333333333.3333333);
+    object.setValue("\r", 5e-324);
+    object.setValue("\xC3\xB6", "tab\there\x0F\"");  // U+00F6
+    json::array& arr = object.emplaceArray("arr");
+    arr.push(-1.5);
+    arr.push(42LL);
+    arr.pushNull();
+
+    std::ostringstream out;
+    bool ok = json::outputCanonical(out, object);
+    const char* expected = 
+        "{\"\\r\":5e-324,\"1\":333333333.3333333,\"a\":100000000000000000000,"
+        "\"arr\":[-1.5,42,null],\"b\":1e+21,\"\xC3\xB6\":\"tab\\there\\u000f\\\"\","
+        "\"\xE2\x82\xAC\":0,\"\xF0\x9F\x98\x80\":1e-7,\"\xEF\xAC\xB3\":0.000001}";
+    ok &= out.str() == expected;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestCanonicalHash(const char* name) {
+    json::object first, second;
+    for(long long i = 0; i < 100; i++) {
+        first.setValue("key" + std::to_string(i), i);
+        second.setValue("key" + std::to_string(99 - i), 99 - i);
+    }
+    first.emplaceObject("inner").setValue("x", "y");
+    second.emplaceObject("inner").setValue("x", "y");
+
+    uint64_t h1 = 0, h2 = 0;
+    json::hash128 w1, w2;
+    bool ok = json::hashCanonical(first, h1) && json::hashCanonical(second, h2) && h1 == h2;
+    ok &= json::hashCanonical(first, w1) && json::hashCanonical(second, w2) && w1 == w2;
+    ok &= w1.low == h1 && w1.high != w1.low;
+
+    second.setValue("key5", 6LL);
+    ok &= json::hashCanonical(second, h2) && h1 != h2;
+    second.setValue("nan", std::nan(""));
+    ok &= !json::hashCanonical(second, h2);
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestDeepDestruction(const char* name) {
+    {
+        // Deep enough to overflow the stack if children were destroyed recursively 
+        json::object root;
+        json::object* current = &root;
+        for(int i = 0; i < 200000; i++) {
+            json::array& arr = current->emplaceArray("a");
+            current = &arr.pushObject();
+        }
+    }
+    // Moved documents keep their children pointed at themselves 
+    json::object moved;
+    json::array& movedArr = moved.emplaceArray("arr");
+    json::object& movedObj = moved.emplaceObject("obj");
+    std::vector<json::object> docs;
+    docs.push_back(std::move(moved));
+    docs.resize(64);
+    docs.reserve(128);
+    bool ok = movedArr.goToParentObject() == &docs[0] && movedObj.goToParentObject() == &docs[0];
+
+    json::reclaimer reclaimer;
+    reclaimer.flush();
+    // Everything allocated for the documents is freed by the time flush returns 
+    size_t allocatedBefore = allocations.load();
+    for(int i = 0; i < 10; i++) {
+        json::object doc;
+        json::array& arr = doc.emplaceArray("arr");
+        for(long long j = 0; j < 1000; j++) arr.pushObject().setValue("j", j);
+        docs.push_back(std::move(doc));
+    }
+    std::unique_ptr<json::array> arr = std::make_unique<json::array>();
+    for(long long j = 0; j < 1000; j++) arr->push(j);
+    size_t allocated = allocations.load() - allocatedBefore;
+    size_t freedBefore = deallocations.load();
+    for(size_t i = 64; i < docs.size(); i++) reclaimer.retire(std::move(docs[i]));
+    reclaimer.retire(std::move(arr));
+    reclaimer.flush();
+    ok &= deallocations.load() - freedBefore >= allocated;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestParallelCopy(const char* name) {
+    json::object original;
+    json::array& records = original.emplaceArray("records");
+    for(long long i = 0; i < 3000; i++) {
+        json::object& rec = records.pushObject();
+        rec.setValue("id", i);
+        rec.setValue("name", "record " + std::to_string(i));
+        rec.emplaceArray("tags").push(i % 2 == 0);
+    }
+    original.emplaceObject("meta").setValue("version", 3.5);
+
+    json::threadPool pool(4);
+    std::unique_ptr<json::object> copy = json::object::copy(original, pool, 50);
+
+    uint64_t h1 = 0, h2 = 0;
+    bool ok = json::hashCanonical(original, h1) && json::hashCanonical(*copy, h2) && h1 == h2;
+
+    json::array* copyRecords;
+    json::object* rec;
+    json::array* tags;
+    ok &= copy->get("records", copyRecords) && copyRecords != &records;
+    ok &= copyRecords->goToParentObject() == copy.get();
+    ok &= copyRecords->get(1234, rec) && rec->goToParentArray() == copyRecords;
+    ok &= rec->get("tags", tags) && tags->goToParentObject() == rec;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestSharedCopy(const char* name) {
+    json::object base;
+    json::object& config = base.emplaceObject("config");
+    config.setValue("port", 8080LL);
+    config.emplaceArray("hosts").push("a");
+    json::object& limits = base.emplaceObject("limits");
+    limits.setValue("rps", 100LL);
+    base.setValue("name", "base");
+
+    std::unique_ptr<json::object> tenant = json::object::copy(base, json::COPY_SHARED);
+    std::unique_ptr<json::object> other = json::object::copy(base, json::COPY_SHARED);
+
+    // Copies share one snapshot of the children, the original keeps its own
+    const json::object* baseLimits;
+    const json::object* tenantLimits;
+    const json::object* otherLimits;
+    bool ok = base.get("limits", baseLimits) && baseLimits == &limits;
+    ok &= tenant->get("limits", tenantLimits) && other->get("limits", otherLimits) && tenantLimits == otherLimits;
+
+    // References into the original taken before the copy change only the original
+    limits.setValue("rps", 5LL);
+    long long rps;
+    ok &= tenantLimits->data.at("rps").getNumber(rps) && rps == 100;
+
+    // Reading through get(key, object*&) doesn't stop the copy from sharing
+    json::object* readLimits;
+    ok &= tenant->get("limits", readLimits) && readLimits->get("rps", rps) && rps == 100;
+    ok &= tenant->get("limits", tenantLimits) && tenantLimits == otherLimits;
+
+    json::object* tenantConfig;
+    json::array* tenantHosts;
+    ok &= tenant->get("config", tenantConfig);
+    ok &= tenantConfig->goToParentObject() == tenant.get();
+    ok &= tenantConfig->get("hosts", tenantHosts);
+    tenantHosts->push("b");
+    tenantConfig->setValue("port", 9090LL);
+    tenant->setValue("name", "tenant");
+
+    long long port;
+    std::string tenantName;
+    const json::object* baseConfig;
+    const json::object* changedConfig;
+    const json::array* baseHosts;
+    ok &= base.get("config", baseConfig) && baseConfig != tenantConfig;
+    ok &= tenant->get("config", changedConfig) && changedConfig == tenantConfig;
+    ok &= baseConfig->get("hosts", baseHosts) && baseHosts->data.size() == 1;
+    ok &= tenantHosts->length() == 2;
+    ok &= tenant->get("name", tenantName) && tenantName == "tenant";
+
+    json::object* otherConfig;
+    ok &= other->get("config", otherConfig) && otherConfig->get("port", port) && port == 8080;
+
+    // Next copy of the changed original shares the unchanged children with the earlier copies
+    std::unique_ptr<json::object> later = json::object::copy(base, json::COPY_SHARED);
+    const json::object* laterLimits;
+    const json::object* laterConfig;
+    ok &= later->get("limits", laterLimits) && laterLimits != otherLimits && laterLimits->data.at("rps").getNumber(rps) && rps == 5;
+    ok &= later->get("config", laterConfig) && other->get("config", baseConfig) && laterConfig == baseConfig;
+
+    // Deep copy of a document with shared children is independent as well 
+    std::unique_ptr<json::object> deep = json::object::copy(*tenant);
+    json::object* deepConfig;
+    ok &= deep->get("config", deepConfig) && deepConfig->get("port", port) && port == 9090;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestFrozenDocument(const char* name) {
+    const char* text = R"({"name": "svc", "port": 8080, "ratio": 0.5, "debug": false, "none": null,
+        "hosts": [{"host": "a", "weight": 1}, {"host": "b", "weight": 2}, [], "tail"],
+        "nested": {"deep": {"key": "value"}}})";
+    std::istringstream in(text);
+    json::frozen_document doc;
+    json::exitCode code;
+    bool ok = json::parse(in, doc, code) == 1 && code.returnCode == json::PARSE_SUCCESS;
+
+    json::frozen_object root = doc.root();
+    std::string service;
+    std::string_view host;
+    long long port, weight;
+    double ratio;
+    bool debug = true;
+    json::types type;
+    json::frozen_array hosts, empty;
+    json::frozen_object entry, deep;
+    ok &= root.size() == 7;
+    ok &= root.get("name", service) && service == "svc";
+    ok &= root.get("port", port) && port == 8080;
+    ok &= root.get("ratio", ratio) && ratio == 0.5;
+    ok &= !root.get("port", ratio);
+    ok &= root.get("debug", debug) && !debug;
+    ok &= root.isNull("none") && !root.contains("missing");
+    // Lookups after a skipped subtree 
+    ok &= root.get("hosts", hosts) && hosts.length() == 4;
+    ok &= hosts.get(1, entry) && entry.get("host", host) && host == "b" && entry.get("weight", weight) && weight == 2;
+    ok &= hosts.get(2, empty) && empty.length() == 0;
+    ok &= hosts.get(3, host) && host == "tail" && !hosts.getType(4, type);
+    ok &= root.get("nested", deep) && deep.get("deep", deep) && deep.get("key", host) && host == "value";
+
+    // Converting the object gives the same data 
+    std::istringstream again(text);
+    json::object obj;
+    json::parse(again, obj, code);
+    json::frozen_document converted(obj);
+    ok &= converted.root().get("hosts", hosts) && hosts.get(0, entry) && entry.get("weight", weight) && weight == 1;
+    ok &= converted.tapeSize() == doc.tapeSize();
+
+    // Errors of the parser are kept 
+    std::istringstream duplicate(R"({"a": {"b": 1, "b": 2}})");
+    json::frozen_document failed;
+    ok &= json::parse(duplicate, failed, code) == 0 && code.returnCode == json::PARSE_ERR_DUPLICATE_ELEMENTS;
+    ok &= failed.root().size() == 0;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestSnapshot(const char* name) {
+    std::string path = (std::filesystem::temp_directory_path() / "parkinson_snapshot_test.bin").string();
+    std::istringstream in(R"({"service": "api", "shards": [{"id": 1, "ratio": 0.25}, {"id": 2, "ratio": 0.75}], "debug": true})");
+    json::frozen_document doc;
+    json::exitCode code;
+    bool ok = json::parse(in, doc, code) == 1;
+    {
+        std::ofstream out(path, std::ios::binary);
+        ok &= json::saveSnapshot(out, doc);
+    }
+
+    // Mapped snapshot outlives the document it was saved from 
+    json::frozen_document loaded;
+    ok &= json::loadSnapshot(path, loaded);
+    doc = json::frozen_document();
+    json::frozen_object root = loaded.root();
+    json::frozen_array shards;
+    json::frozen_object shard;
+    std::string_view service;
+    double ratio;
+    bool debug = false;
+    ok &= root.get("service", service) && service == "api";
+    ok &= root.get("shards", shards) && shards.get(1, shard) && shard.get("ratio", ratio) && ratio == 0.75;
+    ok &= root.get("debug", debug) && debug;
+
+    // Damaged snapshots are rejected 
+    std::string bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::string broken = bytes;
+    broken[39] ^= 0x7f; // Tag of the root word
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(broken.data(), broken.size());
+    }
+    json::frozen_document rejected;
+    ok &= !json::loadSnapshot(path, rejected) && rejected.tape == nullptr;
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(bytes.data(), bytes.size() - 1);
+    }
+    ok &= !json::loadSnapshot(path, rejected);
+    ok &= !json::loadSnapshot(path + ".missing", rejected);
+    std::filesystem::remove(path);
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestCBOR(const char* name) {
+    // Values and their encodings from RFC 8949, Appendix A 
+    auto encodes = [](const json::value& value, std::vector<uint8_t> expected) {
+        std::vector<uint8_t> out;
+        json::encodeCBOR(value, out);
+        json::value back;
+        return out == expected && json::decodeCBOR(out.data(), out.size(), back) && back.type == value.type && back.value == value.value;
+    };
+    json::value v;
+    v.type = json::JSON_NUMBER;
+    v.value = 1000000LL;
+    bool ok = encodes(v, {0x1a, 0x00, 0x0f, 0x42, 0x40});
+    v.value = -1000LL;
+    ok &= encodes(v, {0x39, 0x03, 0xe7});
+    v.value = 1.5;
+    ok &= encodes(v, {0xf9, 0x3e, 0x00});
+    v.value = 5.960464477539063e-8;
+    ok &= encodes(v, {0xf9, 0x00, 0x01});
+    v.value = 100000.0;
+    ok &= encodes(v, {0xfa, 0x47, 0xc3, 0x50, 0x00});
+    v.value = 1.1;
+    ok &= encodes(v, {0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a});
+    v.type = json::JSON_STRING;
+    v.value = std::string("IETF");
+    ok &= encodes(v, {0x64, 0x49, 0x45, 0x54, 0x46});
+
+    // Round trip of the whole object 
+    json::object obj;
+    obj.setValue("name", "svc");
+    obj.setValue("big", 9223372036854775807LL);
+    obj.setValue("min", (long long)(-9223372036854775807LL - 1));
+    obj.setNull("none");
+    json::array& list = obj.emplaceArray("list");
+    list.push(true);
+    list.pushObject().setValue("x", 0.25);
+    std::vector<uint8_t> out;
+    json::encodeCBOR(obj, out);
+    json::object decoded;
+    ok &= json::decodeCBOR(out.data(), out.size(), decoded);
+    std::ostringstream a, b;
+    json::outputCanonical(a, obj);
+    json::outputCanonical(b, decoded);
+    ok &= a.str() == b.str();
+    json::array* decodedList;
+    ok &= decoded.get("list", decodedList) && decodedList->goToParentObject() == &decoded;
+
+    // Indefinite lengths: {_ "a": 1, "b": [_ 2, 3]}
+    std::vector<uint8_t> indefinite = {0xbf, 0x61, 0x61, 0x01, 0x61, 0x62, 0x9f, 0x02, 0x03, 0xff, 0xff};
+    json::object fromIndefinite;
+    long long n;
+    ok &= json::decodeCBOR(indefinite.data(), indefinite.size(), fromIndefinite);
+    ok &= fromIndefinite.get("b", decodedList) && decodedList->get(1, n) && n == 3;
+
+    // Invalid input 
+    std::vector<uint8_t> duplicate = {0xa2, 0x61, 0x61, 0x01, 0x61, 0x61, 0x02};
+    std::vector<uint8_t> bytes = {0xa1, 0x61, 0x61, 0x42, 0x01, 0x02};
+    std::vector<uint8_t> truncated(out.begin(), out.end() - 1);
+    std::vector<uint8_t> trailing = {0xa0, 0x00};
+    json::object bad1, bad2, bad3, bad4;
+    ok &= !json::decodeCBOR(duplicate.data(), duplicate.size(), bad1);
+    ok &= !json::decodeCBOR(bytes.data(), bytes.size(), bad2);
+    ok &= !json::decodeCBOR(truncated.data(), truncated.size(), bad3);
+    ok &= !json::decodeCBOR(trailing.data(), trailing.size(), bad4);
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestMsgPack(const char* name) {
+    // Smallest forms of the values 
+    auto encodes = [](const json::value& value, std::vector<uint8_t> expected) {
+        std::vector<uint8_t> out;
+        json::encodeMsgPack(value, out);
+        json::value back;
+        return out == expected && json::decodeMsgPack(out.data(), out.size(), back) && back.type == value.type && back.value == value.value;
+    };
+    json::value v;
+    v.type = json::JSON_NUMBER;
+    v.value = 127LL;
+    bool ok = encodes(v, {0x7f});
+    v.value = -32LL;
+    ok &= encodes(v, {0xe0});
+    v.value = -129LL;
+    ok &= encodes(v, {0xd1, 0xff, 0x7f});
+    v.value = 65536LL;
+    ok &= encodes(v, {0xce, 0x00, 0x01, 0x00, 0x00});
+    v.value = 0.5;
+    ok &= encodes(v, {0xca, 0x3f, 0x00, 0x00, 0x00});
+    v.type = json::JSON_STRING;
+    v.value = std::string("abc");
+    ok &= encodes(v, {0xa3, 'a', 'b', 'c'});
+
+    // Round trip of the object 
+    json::object obj;
+    obj.setValue("id", 42LL);
+    obj.setValue("price", 0.1);
+    obj.setValue("text", std::string(300, 'x'));
+    json::array& tags = obj.emplaceArray("tags");
+    for(long long i = 0; i < 20; i++) tags.push(i * -1000000000LL);
+    std::vector<uint8_t> out;
+    ok &= json::encodeMsgPack(obj, out);
+    json::object decoded;
+    ok &= json::decodeMsgPack(out.data(), out.size(), decoded);
+    std::ostringstream a, b;
+    json::outputCanonical(a, obj);
+    json::outputCanonical(b, decoded);
+    ok &= a.str() == b.str();
+
+    // Stream of three records fed one byte at a time 
+    std::vector<uint8_t> records;
+    json::encodeMsgPack(obj, records);
+    json::encodeMsgPack(tags, records);
+    records.push_back(0xc3);
+    json::msgpackStream stream;
+    std::vector<json::value> values;
+    for(uint8_t byte: records) {
+        stream.feed(&byte, 1);
+        json::value value;
+        while(stream.next(value) == 1) values.push_back(std::move(value));
+    }
+    ok &= values.size() == 3 && stream.buffered() == 0;
+    ok &= values.size() == 3 && values[0].type == json::JSON_OBJECT && values[1].type == json::JSON_ARRAY && values[2].type == json::JSON_BOOL;
+
+    // SAX decoding counts the values without building them 
+    struct counter : json::msgpackHandler {
+        long long sum = 0;
+        int keys = 0;
+        bool key(std::string_view) override { keys++; return true; }
+        bool value(long long value) override { sum += value; return true; }
+    } handler;
+    ok &= json::decodeMsgPack(out.data(), out.size(), handler);
+    ok &= handler.keys == 4 && handler.sum == 42 - 190000000000LL;
+
+    // Large record split into pieces is passed to the handler once, a record with duplicate keys is skipped 
+    json::array big;
+    for(int i = 0; i < 20000; i++) big.push((long long)i);
+    std::vector<uint8_t> pieces;
+    json::encodeMsgPack(big, pieces);
+    uint8_t duplicate[] = {0x82, 0xa1, 'a', 0x01, 0xa1, 'a', 0x02, 0x07};
+    pieces.insert(pieces.end(), duplicate, duplicate + sizeof(duplicate));
+    json::msgpackStream split;
+    counter total;
+    int completed = 0;
+    for(size_t i = 0; i < pieces.size() - sizeof(duplicate); i += 3) {
+        split.feed(pieces.data() + i, std::min<size_t>(3, pieces.size() - sizeof(duplicate) - i));
+        while(split.next(total) == 1) completed++;
+    }
+    split.feed(duplicate, sizeof(duplicate));
+    json::value last;
+    ok &= completed == 1 && total.sum == 20000LL * 19999 / 2;
+    ok &= split.next(last) == -1 && split.next(last) == 1 && last.type == json::JSON_NUMBER && split.buffered() == 0;
+
+    // Invalid data stops the stream 
+    uint8_t invalid[] = {0xc1, 0xc0};
+    json::msgpackStream broken;
+    broken.feed(invalid, sizeof(invalid));
+    json::value value;
+    ok &= broken.next(value) == -1 && broken.next(value) == -1;
+    uint8_t binary[] = {0x81, 0xa1, 'a', 0xc4, 0x01, 0x00};
+    json::object bad;
+    ok &= !json::decodeMsgPack(binary, sizeof(binary), bad);
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestParseBatch(const char* name) {
+    std::vector<std::string> texts;
+    for(int i = 0; i < 200; i++) {
+        std::string text = "{\"id\": " + std::to_string(i) + ", \"items\": [";
+        // Every tenth document is much bigger than the others 
+        int items = i % 10 == 0 ? 2000 : 3;
+        for(int j = 0; j < items; j++) text += (j ? ", " : "") + std::to_string(j);
+        texts.push_back(text + "]}");
+    }
+    texts[7] = "{\"id\": 7";
+    std::vector<std::string_view> inputs(texts.begin(), texts.end());
+    std::vector<json::object> outs;
+    std::vector<json::exitCode> codes;
+    json::threadPool pool(4);
+    bool ok = json::parseBatch(inputs, outs, codes, pool) == 199;
+    ok &= outs.size() == 200 && codes.size() == 200;
+    ok &= codes[7].returnCode == json::PARSE_ERR_INCORRECT_OBJECT_ENDING;
+    for(int i = 0; i < 200 && ok; i++) {
+        if(i == 7) continue;
+        long long id;
+        json::array* items;
+        ok &= codes[i].returnCode == json::PARSE_SUCCESS;
+        ok &= outs[i].get("id", id) && id == i;
+        ok &= outs[i].get("items", items) && items->length() == (i % 10 == 0 ? 2000 : 3);
+        ok &= items->goToParentObject() == &outs[i];
+    }
+    // Same results with the threads of the batch itself and when outs are reused 
+    ok &= json::parseBatch(inputs, outs, codes, 2) == 199;
+    long long id;
+    ok &= outs[42].get("id", id) && id == 42 && outs[42].data.size() == 2;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestIngestFiles(const char* name) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "parkinson_ingest_test";
+    std::filesystem::create_directories(dir);
+    std::vector<std::string> paths;
+    for(int i = 0; i < 300; i++) {
+        std::string path = (dir / (std::to_string(i) + ".json")).string();
+        std::ofstream out(path);
+        out << "{\"id\": " << i << ", \"pad\": \"" << std::string(i * 10, 'x') << "\"}";
+        paths.push_back(path);
+    }
+    paths[5] = (dir / "missing.json").string();
+    {
+        std::ofstream out(paths[6]);
+        out << "{\"id\": ";
+    }
+
+    bool ok = true;
+    for(bool uring: {true, false}) {
+        json::ingestConfig config;
+        config.useIoUring = uring;
+        config.parserThreads = 3;
+        config.readsInFlight = 8;
+        // Much less than all the files together, readers have to wait for the parsers 
+        config.maxBufferedBytes = 4096;
+        std::mutex lock;
+        std::vector<int> seen(paths.size(), 0);
+        bool right = true;
+        size_t parsed = json::ingestFiles(paths, [&](size_t index, std::unique_ptr<json::object> object, const json::exitCode& code) {
+            std::lock_guard<std::mutex> guard(lock);
+            seen[index]++;
+            long long id;
+            if(index == 5) right &= code.returnCode == json::PARSE_ERR_IO;
+            else if(index == 6) right &= code.returnCode == json::PARSE_ERR_INCORRECT_OBJECT_ENDING;
+            else right &= code.returnCode == json::PARSE_SUCCESS && object->get("id", id) && id == (long long)index;
+        }, config);
+        ok &= parsed == 298 && right;
+        for(int count: seen) ok &= count == 1;
+    }
+    std::filesystem::remove_all(dir);
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+// Task awaiting the parse, to check that tasks can be chained 
+json::task<long long> asyncSum(int fd, json::executor& executor, json::exitCode& code) {
+    json::object object = co_await json::parseAsync(fd, executor, code);
+    long long sum = 0;
+    json::array* values;
+    if(object.get("values", values)) {
+        for(int i = 0; i < values->length(); i++) {
+            long long value;
+            if(values->get(i, value)) sum += value;
+        }
+        // Moved object still owns its children 
+        if(values->goToParentObject() == &object) sum = -sum;
+    }
+    co_return std::move(sum);
+}
+
+bool runTestParseAsync(const char* name) {
+    const int sources = 8;
+    int pipes[sources][2];
+    for(auto& ends: pipes) {
+        if(pipe(ends) != 0) return false;
+        fcntl(ends[0], F_SETFL, fcntl(ends[0], F_GETFL) | O_NONBLOCK);
+    }
+    json::epollExecutor executor;
+    std::vector<json::exitCode> codes(sources);
+    std::vector<json::task<json::object>> tasks;
+    for(int i = 0; i < sources - 2; i++) {
+        tasks.push_back(json::parseAsync(pipes[i][0], executor, codes[i]));
+        tasks.back().start();
+    }
+    json::task<long long> sum = asyncSum(pipes[sources - 2][0], executor, codes[sources - 2]);
+    sum.start();
+    json::task<json::object> broken = json::parseAsync(pipes[sources - 1][0], executor, codes[sources - 1]);
+    broken.start();
+
+    // Writer sends every document in small pieces, interleaved between the sources 
+    std::thread writer([&] {
+        std::vector<std::string> texts;
+        for(int i = 0; i < sources - 2; i++) texts.push_back("{\"id\": " + std::to_string(i) + ", \"name\": \"source " + std::to_string(i) + "\"}");
+        texts.push_back("{\"values\": [1, 2, 3, 4, 5]}");
+        texts.push_back("{\"unfinished\": [1, 2");
+        for(size_t offset = 0; offset < 40; offset += 5) {
+            for(int i = 0; i < sources; i++) {
+                if(offset < texts[i].size()) {
+                    std::string piece = texts[i].substr(offset, 5);
+                    if(write(pipes[i][1], piece.data(), piece.size()) < 0) return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        for(auto& ends: pipes) close(ends[1]);
+    });
+    executor.run();
+    writer.join();
+
+    bool ok = executor.waiting() == 0;
+    for(int i = 0; i < sources - 2; i++) {
+        long long id;
+        std::string text;
+        ok &= tasks[i].done() && codes[i].returnCode == json::PARSE_SUCCESS;
+        ok &= tasks[i].result().get("id", id) && id == i;
+        ok &= tasks[i].result().get("name", text) && text == "source " + std::to_string(i);
+    }
+    ok &= sum.done() && sum.result() == -15;
+    ok &= broken.done() && codes[sources - 1].returnCode == json::PARSE_ERR_INCORRECT_OBJECT_ENDING;
+    for(auto& ends: pipes) close(ends[0]);
+
+    // Two documents arriving in one piece, bytes after the first one are kept for the second 
+    int ends[2];
+    if(pipe(ends) != 0) return false;
+    fcntl(ends[0], F_SETFL, fcntl(ends[0], F_GETFL) | O_NONBLOCK);
+    std::string both = "{\"n\": 1} {\"n\": 2}";
+    ok &= write(ends[1], both.data(), both.size()) == ssize_t(both.size());
+    std::string pending;
+    json::exitCode first, second;
+    long long n1 = 0, n2 = 0;
+    json::task<json::object> one = json::parseAsync(ends[0], executor, first, pending);
+    one.start();
+    executor.run();
+    json::task<json::object> two = json::parseAsync(ends[0], executor, second, pending);
+    two.start();
+    executor.run();
+    ok &= one.done() && one.result().get("n", n1) && n1 == 1;
+    ok &= two.done() && two.result().get("n", n2) && n2 == 2 && pending.empty();
+
+    // Task destroyed while it waits is never resumed 
+    {
+        json::exitCode dropped;
+        json::task<json::object> waiting = json::parseAsync(ends[0], executor, dropped);
+        waiting.start();
+        ok &= executor.waiting() == 1;
+    }
+    ok &= executor.waiting() == 0 && write(ends[1], "{}", 2) == 2 && executor.poll(0) == 0;
+    close(ends[0]);
+    close(ends[1]);
+
+    // Executor that can't wait ends the parse instead of reading again and again 
+    struct refusing : json::executor {
+        bool waitReadable(int, std::coroutine_handle<>) override { return false; }
+        void cancel(int, std::coroutine_handle<>) override {}
+    } refuse;
+    if(pipe(ends) != 0) return false;
+    fcntl(ends[0], F_SETFL, fcntl(ends[0], F_GETFL) | O_NONBLOCK);
+    json::exitCode refused;
+    json::task<json::object> unwaited = json::parseAsync(ends[0], refuse, refused);
+    unwaited.start();
+    ok &= unwaited.done() && refused.returnCode == json::PARSE_ERR_IO;
+    close(ends[0]);
+    close(ends[1]);
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestReusableParser(const char* name) {
+    // Strings are short enough to be kept inside of std::string 
+    const char* text = R"({"id": 1, "user": {"name": "ann", "tags": ["a", "b", {"deep": [1, 2.5, true, null]}]},
+        "items": [{"sku": "x1", "qty": 2}, {"sku": "x2", "qty": 3}, {"sku": "x3", "qty": 4}]})";
+    json::parser parser;
+    json::object object;
+    json::exitCode code;
+    bool ok = parser.parse(text, object, code) == 1;
+    parser.recycle(object);
+    ok &= object.data.empty() && parser.recycled() > 0;
+
+    // Second document of the same shape takes everything from the free list 
+    size_t before = allocations.load();
+    ok &= parser.parse(text, object, code) == 1;
+    size_t allocated = allocations.load() - before;
+    ok &= allocated == 0;
+
+    json::array* items;
+    json::object* item;
+    std::string sku;
+    long long qty;
+    ok &= object.get("items", items) && items->get(2, item) && item->get("sku", sku) && sku == "x3";
+    ok &= item->get("qty", qty) && qty == 4 && item->goToParentArray() == items && items->goToParentObject() == &object;
+
+    // Recycled structures keep working after a differently shaped document and the limit 
+    parser.recycle(object);
+    std::istringstream other(R"({"list": [[], [[]], {"a": {"b": {}}}]})");
+    ok &= parser.parse(other, object, code) == 1;
+    std::ostringstream out;
+    json::outputObject(out, object);
+    json::object check;
+    std::istringstream again(out.str());
+    ok &= json::parse(again, check, code) == 1 && check.data.size() == 1;
+    parser.setLimit(2);
+    parser.recycle(object);
+    ok &= parser.recycled() <= 6;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestProjection(const char* name) {
+    const char* text = R"({"id": 1, "user": {"name": "ann", "tags": ["a", "b"], "a/b": 5},
+        "items": [{"sku": "x1", "qty": 2}, {"sku": "x2", "qty": 3}, {"sku": "x3", "qty": 4}], "rest": [1, {"x": null}]})";
+    json::projection paths;
+    bool ok = paths.addPointer("/user/name") && paths.addPointer("/items/2/sku") && paths.addPointer("/user/a~1b");
+    paths.addKey("id");
+    ok &= !paths.addPointer("user") && !paths.addPointer("/a~2") && !paths.addPointer("/a~");
+
+    json::object object;
+    json::exitCode code;
+    ok &= json::parse(text, object, code, paths) == 1 && code.returnCode == json::PARSE_SUCCESS;
+    json::object* user;
+    json::array* items;
+    json::object* item;
+    std::string value;
+    long long number;
+    ok &= object.data.size() == 3 && object.get("id", number) && number == 1;
+    ok &= object.get("user", user) && user->data.size() == 2 && user->get("name", value) && value == "ann";
+    ok &= user->get("a/b", number) && number == 5;
+    // Skipped elements before the selected one are null
+    ok &= object.get("items", items) && items->data.size() == 3 && items->data[0].type == json::JSON_NULL;
+    ok &= items->get(2, item) && item->data.size() == 1 && item->get("sku", value) && value == "x3";
+    ok &= item->goToParentArray() == items && items->goToParentObject() == &object;
+
+    // Skipped part is still checked
+    json::object broken;
+    ok &= json::parse(R"({"rest": [1, 2,, 3], "id": 1})", broken, code, paths) == 0;
+
+    // Skipped subtrees cost nothing, no matter how big they are
+    std::string big = R"({"id": 1, "skip": [)";
+    for(int i = 0; i < 100; i++) big += R"({"long string that is not kept inside of std::string": [1.5, "another long string of the skipped part"]},)";
+    big += "{}]}";
+    const char* small = R"({"id": 1, "skip": []})";
+    json::object warm, first, second;
+    ok &= json::parse(big, warm, code, paths) == 1;
+    size_t before = allocations.load();
+    ok &= json::parse(small, first, code, paths) == 1;
+    size_t smallAllocations = allocations.load() - before;
+    before = allocations.load();
+    ok &= json::parse(big, second, code, paths) == 1;
+    ok &= allocations.load() - before == smallAllocations && second.data.size() == 1;
+
+    // Empty pointer selects the whole document
+    json::projection whole;
+    ok &= whole.addPointer("");
+    json::object all;
+    std::istringstream in(text);
+    ok &= json::parse(in, all, code, whole) == 1 && all.data.size() == 4;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestEarlyStop(const char* name) {
+    std::string text = R"({"type": "order", "id": 7, "tenant": {"name": "acme"}, "payload": [1, 2, 3], "rest": tru})";
+    json::projection paths;
+    paths.addKey("type");
+    paths.addPointer("/tenant/name");
+    paths.stopWhenFound = true;
+
+    // Parse stops right after the tenant, broken value after it is never read
+    std::istringstream in(text);
+    json::object object;
+    json::exitCode code;
+    bool ok = json::parse(in, object, code, paths) == 1 && code.returnCode == json::PARSE_SUCCESS;
+    std::string type, tenant;
+    json::object* tenantObject;
+    ok &= object.data.size() == 2 && object.get("type", type) && type == "order";
+    ok &= object.get("tenant", tenantObject) && tenantObject->get("name", tenant) && tenant == "acme";
+    std::string unread(std::istreambuf_iterator<char>(in), {});
+    ok &= unread == R"(, "payload": [1, 2, 3], "rest": tru})";
+
+    // Checking the rest finds the error, but builds nothing more
+    paths.checkRest = true;
+    json::object checked;
+    ok &= json::parse(text, checked, code, paths) == 0 && code.returnCode == json::PARSE_ERR_INCORRECT_BOOL_DEFINITION;
+    text.replace(text.find("tru}"), 4, "true}");
+    json::object valid;
+    ok &= json::parse(text, valid, code, paths) == 1 && valid.data.size() == 2;
+
+    // Member that isn't in the text means the whole text is read
+    paths.addKey("missing");
+    paths.checkRest = false;
+    json::object all;
+    ok &= json::parse(text, all, code, paths) == 1 && all.data.size() == 2;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestLazyNumbers(const char* name) {
+    const char* text = R"({"int": 12, "neg": -0.50, "exp": 1.0E+2, "list": [3, 2.50, 1e-3]})";
+    json::parseConfig config;
+    config.lazyNumbers = true;
+    json::object object;
+    json::exitCode code;
+    bool ok = json::parse(text, object, code, config) == 1;
+    ok &= std::holds_alternative<json::rawNumber>(object.data["neg"].value);
+    // Lazy numbers don't make the values bigger 
+    ok &= sizeof(json::rawNumber) <= sizeof(std::string);
+
+    // Getters convert on the first read, types follow the text the same way as without lazyNumbers 
+    long long integer;
+    double real;
+    json::array* list;
+    ok &= object.get("int", integer) && integer == 12 && !object.get("int", real);
+    ok &= object.get("neg", real) && real == -0.5 && object.get("neg", real) && real == -0.5 && !object.get("neg", integer);
+    ok &= object.get("exp", real) && real == 100;
+    ok &= object.get("list", list) && list->get(0, integer) && integer == 3 && list->get(2, real) && real == 0.001;
+
+    // Output writes the numbers exactly as they were, copies keep them too 
+    std::ostringstream out;
+    json::outputObject(out, *json::object::copy(object));
+    ok &= out.str().find("-0.50") != std::string::npos && out.str().find("1.0E+2") != std::string::npos;
+    ok &= out.str().find("2.50") != std::string::npos && out.str().find("1e-3") != std::string::npos;
+
+    // Encoded forms are the same as of the converted numbers 
+    json::object eager;
+    ok &= json::parse(text, eager, code) == 1;
+    std::vector<uint8_t> lazyCBOR, eagerCBOR;
+    json::encodeCBOR(*object.data["list"].getArray(), lazyCBOR);
+    json::encodeCBOR(*eager.data["list"].getArray(), eagerCBOR);
+    ok &= lazyCBOR == eagerCBOR;
+    uint64_t lazyHash, eagerHash;
+    ok &= json::hashCanonical(object, lazyHash) && json::hashCanonical(eager, eagerHash) && lazyHash == eagerHash;
+
+    // Numbers that weren't read yet can be read by several threads at once 
+    json::object fresh;
+    ok &= json::parse(text, fresh, code, config) == 1;
+    const json::value& shared = fresh.data["exp"];
+    std::atomic<int> matching = 0;
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 4; i++) {
+        readers.emplace_back([&] {
+            double value;
+            if(shared.getNumber(value) && value == 100) matching++;
+        });
+    }
+    for(auto& reader: readers) reader.join();
+    ok &= matching == 4;
+
+    // Numbers out of the range are still found during the parse
+    json::object overflow;
+    ok &= json::parse(R"({"big": 1e999})", overflow, code, config) == 0 && code.returnCode == json::PARSE_ERR_NUMBER_OVERFLOW_OR_UNDERFLOW;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestValidate(const char* name) {
+    json::exitCode code;
+    const char* valid = "{\"name\": \"caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80\", \"list\": [1, 2.5, {\"a\": null}], \"ok\": true}";
+    bool ok = json::validate(valid, code) == 1 && code.returnCode == json::PARSE_SUCCESS;
+
+    // Errors are the same as of the parse 
+    const char* broken[] = {
+        R"({"a": 1, "a": 2})",
+        R"({"a": [1, 2})",
+        R"({"a": tru})",
+        R"({"a": 1e999})",
+        R"({"a": {"b": 1, "b": 2}})",
+        R"({"a" 1})",
+        "{\n\t\"a\": [1,\n  }"
+    };
+    for(const char* text: broken) {
+        json::object object;
+        json::exitCode parseCode;
+        json::parse(text, object, parseCode);
+        ok &= json::validate(text, code) == 0 && code.returnCode == parseCode.returnCode;
+        ok &= code.lineNumber == parseCode.lineNumber && code.characterNumber == parseCode.characterNumber;
+    }
+
+    // Overlong form, surrogate, cut sequence and a byte that can't start one
+    const char* badUTF8[] = {"{\"a\": \"\xC0\x80\"}", "{\"a\": \"\xED\xA0\x80\"}", "{\"a\": \"\xE2\x82\"}", "{\"a\": \"\xFF\"}"};
+    for(const char* text: badUTF8) {
+        ok &= json::validate(text, code) == 0 && code.returnCode == json::PARSE_ERR_INVALID_UTF8;
+        ok &= code.lineNumber == 1 && code.characterNumber == 9;
+    }
+    // Error that comes first in the text is reported
+    ok &= json::validate("{\"a\" 1, \"b\": \"\xFF\"}", code) == 0 && code.returnCode == json::PARSE_ERR_INCORRECT_KEY_VALUE_SEPARATOR;
+
+    // Checking documents one after another stops allocating once the kept keys are long enough 
+    std::string big = "{";
+    for(int i = 0; i < 100; i++) big += "\"key number " + std::to_string(i) + " that is long enough\": [\"text\", 1, {\"x\": false}],";
+    big += "\"end\": 0}";
+    for(int i = 0; i < 4; i++) ok &= json::validate(big, code) == 1;
+    size_t before = allocations.load();
+    ok &= json::validate(big, code) == 1;
+    ok &= allocations.load() == before;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestErrorLocation(const char* name) {
+    const char* text = "{\n\t\"a\": [1,\n  }, \"rest\": 1}";
+    json::exitCode code;
+    json::object object;
+    bool ok = json::parse(std::string_view(text), object, code) == 0 && code.returnCode == json::PARSER_ERR_COMMA_AFTER_LAST_ELEMENT;
+    ok &= code.message == "PARSER_ERR_COMMA_AFTER_LAST_ELEMENT" && code.offset == 15 && code.lineNumber == 3 && code.characterNumber == 4;
+
+    // Stream is read again to find the line, and is left where the parser stopped 
+    std::istringstream in(text);
+    json::object streamed;
+    json::exitCode streamCode;
+    ok &= json::parse(in, streamed, streamCode) == 0 && streamCode.lineNumber == 3 && streamCode.characterNumber == 4;
+    ok &= in.tellg() == 15;
+
+    // Successful parse has no location
+    json::object valid;
+    ok &= json::parse(R"({"a": 1})", valid, code) == 1 && code.lineNumber == 0 && code.offset == 0 && code.message == "PARSE_SUCCESS";
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestKeyWhitespace(const char* name) {
+    // Whitespace inside of keys is kept whether the text is read from a stream or from the memory
+    const char* text = R"({"": {}, "  ": 1, " first name\t": 2})";
+    json::exitCode code;
+    json::object fromText;
+    bool ok = json::parse(std::string_view(text), fromText, code) == 1;
+
+    std::istringstream in(text);
+    json::object fromStream;
+    ok &= json::parse(in, fromStream, code) == 1;
+
+    std::set<std::string> textKeys, streamKeys;
+    for(const auto& [key, value]: fromText.data) textKeys.insert(key);
+    for(const auto& [key, value]: fromStream.data) streamKeys.insert(key);
+    ok &= textKeys == streamKeys && textKeys == std::set<std::string>{"", "  ", " first name\t"};
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+// Streambuf giving the text in pieces of the given size, or character by character without the get area if it is 0.
+// It can't seek, so lines of the errors are counted while reading
+struct pieceBuffer : std::streambuf {
+    std::string text;
+    size_t piece;
+    size_t at = 0;
+    pieceBuffer(std::string text, size_t piece) : text(std::move(text)), piece(piece) {}
+    int_type underflow() override {
+        if(at == text.size()) return traits_type::eof();
+        if(piece == 0) return traits_type::to_int_type(text[at]);
+        size_t size = std::min(piece, text.size() - at);
+        setg(text.data() + at, text.data() + at, text.data() + at + size);
+        at += size;
+        return traits_type::to_int_type(*gptr());
+    }
+    int_type uflow() override {
+        if(piece > 0) return std::streambuf::uflow();
+        if(at == text.size()) return traits_type::eof();
+        return traits_type::to_int_type(text[at++]);
+    }
+};
+
+bool runTestStreamPieces(const char* name) {
+    // Tokens are cut by the ends of the get area, the stream is left right after the root
+    std::string text = R"({"a b": [1, 22.5, -3e2, "x \"y\"", true, null], "c": {"d": false}, "records": [{"id": 1}, {"id": 2}]} rest)";
+    json::object expected;
+    json::exitCode code;
+    uint64_t hash = 0;
+    bool ok = json::parse(std::string_view(text), expected, code) == 1 && json::hashCanonical(expected, hash);
+    std::string broken = "{\n\t\"a\": [1,\n  }, \"rest\": 1}";
+    for(size_t piece: {0, 1, 3, 64}) {
+        pieceBuffer buffer(text, piece);
+        std::istream in(&buffer);
+        json::object streamed;
+        uint64_t streamedHash = 0;
+        ok &= json::parse(in, streamed, code) == 1 && json::hashCanonical(streamed, streamedHash) && streamedHash == hash;
+        std::string unread(std::istreambuf_iterator<char>(in), {});
+        ok &= unread == " rest";
+
+        // Elements are taken one by one from the pieces
+        pieceBuffer elements(text, piece);
+        std::istream elementStream(&elements);
+        json::arrayReader reader(elementStream, "/records");
+        json::value element;
+        size_t count = 0;
+        while(reader.next(element) == 1) count++;
+        ok &= count == 2 && reader.code.returnCode == json::PARSE_SUCCESS;
+
+        pieceBuffer brokenBuffer(broken, piece);
+        std::istream brokenStream(&brokenBuffer);
+        json::object failed;
+        ok &= json::parse(brokenStream, failed, code) == 0 && code.returnCode == json::PARSER_ERR_COMMA_AFTER_LAST_ELEMENT;
+        ok &= code.lineNumber == 3 && code.characterNumber == 4;
+    }
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestParseParallel(const char* name) {
+    // Strings with escaped quotes, runs of backslashes and structural characters cross the chunk borders
+    std::string text = "{\"items\": [";
+    for(int i = 0; i < 300; i++) {
+        if(i > 0) text += ",\n  ";
+        text += "{\"id\": " + std::to_string(i) + ", \"name\": \"say \\\"hi\\\", {[:,]}\", \"path\": \"C:\\\\dir\\\\\", ";
+        text += "\"values\": [" + std::to_string(i * 0.5) + ", -" + std::to_string(i) + "e2, true, null, false, []], \"empty\": {}}";
+    }
+    text += "], \"tail\": \"\\u0041\"} trailing";
+    json::object expected;
+    json::exitCode code;
+    bool ok = json::parse(std::string_view(text), expected, code) == 1;
+    uint64_t expectedHash = 0, hash = 0;
+    ok &= json::hashCanonical(expected, expectedHash);
+    for(size_t chunkBytes: {64, 100, 1000, 1 << 24}) {
+        json::object object;
+        ok &= json::parseParallel(text, object, code, 4, chunkBytes) == 1 && code.returnCode == json::PARSE_SUCCESS;
+        ok &= json::hashCanonical(object, hash) && hash == expectedHash;
+    }
+
+    // Errors are the ones of parse
+    for(const char* bad: {"{\"a\": [1, 2,], \"b\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"}",
+                          "{\"a\": 1, \"a\": 2, \"b\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"}",
+                          "{\"a\": tru e, \"b\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"}",
+                          "{\"a\": 01, \"b\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"}",
+                          "{\"a\": \"b\" \"c\", \"b\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"}",
+                          "{\"a\": [1, 2, \"b\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"}) {
+        json::object object, reference;
+        json::exitCode parallelCode, referenceCode;
+        int result = json::parseParallel(bad, object, parallelCode, 2, 64);
+        ok &= result == json::parse(std::string_view(bad), reference, referenceCode);
+        ok &= parallelCode.returnCode == referenceCode.returnCode && parallelCode.offset == referenceCode.offset;
+        ok &= parallelCode.lineNumber == referenceCode.lineNumber && parallelCode.characterNumber == referenceCode.characterNumber;
+    }
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestSidecar(const char* name) {
+    std::string path = (std::filesystem::temp_directory_path() / "parkinson_sidecar_test.json").string();
+    std::string indexPath = path + ".idx";
+    std::string text = R"({"a": {"b": [1, {"c": "x\"y"}, [2, 3], {"c": 2.5}], "kéy": true}, "list": [)";
+    for(int i = 0; i < 100; i++) text += (i > 0 ? ", " : "") + std::to_string(i * 3);
+    text += R"(], "deep": {"x": {"y": {"z": {"w": [7, null]}}}}, "s": "{[,:]}"})";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    json::object expected;
+    json::exitCode code;
+    bool ok = json::parse(std::string_view(text), expected, code) == 1;
+    uint64_t expectedHash = 0, hash = 0;
+    ok &= json::hashCanonical(expected, expectedHash);
+
+    // Same values are found however many levels are indexed
+    for(unsigned levels: {1, 2, 8}) {
+        json::sidecar_index index;
+        ok &= json::buildSidecar(path, indexPath, code, levels) == 1 && code.returnCode == json::PARSE_SUCCESS;
+        ok &= json::loadSidecar(path, indexPath, index);
+        json::value v;
+        ok &= index.get("/a/b/3/c", v) && std::get<double>(v.value) == 2.5;
+        ok &= index.get("/a/b/1/c", v) && std::get<std::string>(v.value) == "x\"y";
+        ok &= index.get("/a/k\xC3\xA9y", v) && std::get<bool>(v.value);
+        ok &= index.get("/list/57", v) && std::get<long long>(v.value) == 171;
+        ok &= index.get("/deep/x/y/z/w/1", v) && v.type == json::JSON_NULL;
+        ok &= index.get("/s", v) && std::get<std::string>(v.value) == "{[,:]}";
+        ok &= index.get("/a/b/2", v) && v.type == json::JSON_ARRAY && std::get<std::unique_ptr<json::array>>(v.value)->data.size() == 2;
+        ok &= index.get("", v) && json::hashCanonical(*std::get<std::unique_ptr<json::object>>(v.value), hash) && hash == expectedHash;
+        ok &= !index.get("/nope", v) && !index.get("/list/100", v) && !index.get("/list/01", v) && !index.get("/a/b/0/c", v) && !index.get("a", v);
+    }
+
+    // Index of the changed file isn't loaded
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << "\n";
+    }
+    json::sidecar_index stale;
+    ok &= !json::loadSidecar(path, indexPath, stale);
+    ok &= !json::loadSidecar(path + ".missing", indexPath, stale);
+
+    // Text that isn't valid gets the error of validate
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << R"({"a": [1, 2,, 3]})";
+    }
+    json::exitCode expectedCode;
+    ok &= json::buildSidecar(path, indexPath, code) == 0 && json::validate(R"({"a": [1, 2,, 3]})", expectedCode) == 0;
+    ok &= code.returnCode == expectedCode.returnCode && code.offset == expectedCode.offset;
+    std::filesystem::remove(path);
+    std::filesystem::remove(indexPath);
+    ok &= json::buildSidecar(path, indexPath, code) == 0 && code.returnCode == json::PARSE_ERR_IO;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestArrayReader(const char* name) {
+    std::string text = R"({"meta": {"records": [0]}, "groups": [[9], {"records": [1]}, [{"id": -1}, "x", 2.5, null, [true]]], "records": [)";
+    for(int i = 0; i < 50; i++) text += (i > 0 ? ", " : "") + std::string(R"({"id": )") + std::to_string(i) + R"(, "tags": ["a", "b"]})";
+    text += R"(], "after": {"records": "no"}})";
+    json::object whole;
+    json::exitCode code;
+    bool ok = json::parse(std::string_view(text), whole, code) == 1;
+    json::array* records = nullptr;
+    ok &= whole.get("records", records);
+
+    // Same elements from the text and from the stream, parent of the element is gone
+    std::istringstream in(text);
+    json::arrayReader fromText(text, "/records");
+    json::arrayReader fromStream(in, "/records");
+    for(json::arrayReader* reader: {&fromText, &fromStream}) {
+        json::value element;
+        size_t count = 0;
+        while(reader->next(element) == 1) {
+            json::object* object = std::get<std::unique_ptr<json::object>>(element.value).get();
+            json::object* expected = nullptr;
+            uint64_t h1 = 0, h2 = 0;
+            ok &= count < records->data.size() && records->get(count, expected);
+            ok &= json::hashCanonical(*object, h1) && json::hashCanonical(*expected, h2) && h1 == h2;
+            ok &= object->parent == nullptr && object->parentArray == nullptr;
+            count++;
+        }
+        ok &= count == 50 && reader->found() && reader->code.returnCode == json::PARSE_SUCCESS && reader->next(element) == 0;
+    }
+
+    // Array inside of an array, elements of any type
+    json::arrayReader nested(text, "/groups/2");
+    json::value element;
+    ok &= nested.next(element) == 1 && element.type == json::JSON_OBJECT;
+    ok &= nested.next(element) == 1 && std::get<std::string>(element.value) == "x";
+    ok &= nested.next(element) == 1 && std::get<double>(element.value) == 2.5;
+    ok &= nested.next(element) == 1 && element.type == json::JSON_NULL;
+    ok &= nested.next(element) == 1 && std::get<std::unique_ptr<json::array>>(element.value)->data.size() == 1;
+    ok &= nested.next(element) == 0 && nested.code.returnCode == json::PARSE_SUCCESS;
+
+    // Missing arrays and pointers to other values have no elements
+    for(const char* pointer: {"/missing", "/after/records", "/groups/1", "records", ""}) {
+        json::arrayReader none(text, pointer);
+        ok &= none.next(element) == 0 && !none.found() && none.code.returnCode == json::PARSE_SUCCESS;
+    }
+
+    // Errors after the array are found once it ends
+    const char* broken = R"({"records": [1, 2], "rest": [1,, 2]})";
+    json::arrayReader failing(std::string_view(broken), "/records");
+    json::object reference;
+    json::exitCode referenceCode;
+    json::parse(std::string_view(broken), reference, referenceCode);
+    ok &= failing.next(element) == 1 && failing.next(element) == 1 && failing.next(element) == 0;
+    ok &= failing.code.returnCode == referenceCode.returnCode && failing.code.offset == referenceCode.offset;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestDocumentReader(const char* name) {
+    // Concatenated, whitespace separated and RFC 7464 records in one text
+    std::string text = "{\"a\": 1}{\"b\": [1, 2]}\n\x1e{\"c\": {}}  \x1e\n{\"d\": \"}{\"}\n";
+    std::vector<std::string> expected = {"{\"a\": 1}", "{\"b\": [1, 2]}", "{\"c\": {}}", "{\"d\": \"}{\"}"};
+    std::istringstream in(text);
+    json::documentReader fromText(text);
+    json::documentReader fromStream(in);
+    bool ok = true;
+    for(json::documentReader* reader: {&fromText, &fromStream}) {
+        size_t count = 0;
+        json::object document;
+        while(reader->next(document) == 1) {
+            ok &= count < expected.size() && text.substr(reader->begin, reader->end - reader->begin) == expected[count];
+            document.clear();
+            count++;
+        }
+        ok &= count == 4 && reader->code.returnCode == json::PARSE_SUCCESS && reader->next(document) == 0;
+    }
+    json::object last;
+    json::documentReader again(text);
+    for(int i = 0; i < 4; i++) {
+        last.clear();
+        ok &= again.next(last) == 1;
+    }
+    std::string d;
+    ok &= last.get("d", d) && d == "}{";
+
+    // Errors are located in the whole text
+    std::string broken = "{\"a\": 1}\n{\"b\": [1,,]}";
+    json::documentReader failing(broken);
+    json::object document;
+    json::object second;
+    json::exitCode secondCode;
+    json::parse(std::string_view(broken).substr(9), second, secondCode);
+    json::object failed;
+    ok &= failing.next(document) == 1 && failing.next(failed) == 0 && failing.code.returnCode == secondCode.returnCode;
+    ok &= failing.code.offset == secondCode.offset + 9 && failing.code.lineNumber == 2 && failing.code.characterNumber == secondCode.characterNumber;
+    ok &= failing.next(document) == 0;
+    json::documentReader garbage(std::string_view("{} x"));
+    ok &= garbage.next(document) == 1 && garbage.next(document) == 0 && garbage.code.returnCode == json::PARSE_ERR_INCORRECT_OBJECT_START;
+    ok &= garbage.code.offset == 4;
+    json::documentReader empty(std::string_view(" \n"));
+    ok &= empty.next(document) == 0 && empty.code.returnCode == json::PARSE_SUCCESS;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
+bool runTestPaths(const char* name) {
+    const char* text = R"({"orders": [{"id": 7, "items": [{"price": 1.5}, {"price": 2}, {"price": 3.25}, {"price": 9.75, "tag": "last"}]}],
+        "a/b": {"m~n": true}, "0": {"01": "key"}, "count": 4})";
+    json::object root;
+    json::exitCode code;
+    bool ok = json::parse(std::string_view(text), root, code) == 1;
+
+    json::path price = json::path::compile("/orders/0/items/3/price");
+    double d = 0;
+    long long i = 0;
+    bool b = false;
+    std::string s;
+    const json::object* o = nullptr;
+    const json::array* a = nullptr;
+    ok &= price.valid() && price.get(root, d) && d == 9.75;
+    ok &= json::path::compile("/orders/0/items/1/price").get(root, i) && i == 2;
+    ok &= json::path::compile("/orders/0/items/3/tag").get(root, s) && s == "last";
+    ok &= json::path::compile("/a~1b/m~0n").get(root, b) && b;
+    ok &= json::path::compile("/0/01").get(root, s) && s == "key";
+    ok &= json::path::compile("/orders/0").get(root, o) && o->data.contains("items");
+    ok &= json::path::compile("/orders/0/items").get(root, a) && a->data.size() == 4;
+    ok &= json::path::compile("").get(root, o) && o == &root;
+    // Missing values, wrong types, malformed pointers and indexes
+    ok &= !json::path::compile("/orders/1/items").get(root, a) && !json::path::compile("/orders/00").get(root, o);
+    ok &= !json::path::compile("/count").get(root, s) && !json::path::compile("/count/0").get(root, i);
+    ok &= !json::path::compile("orders").valid() && !json::path::compile("/a~2").get(root, b) && !json::path::compile("/nope").get(root, i);
+
+    // Compiled path is used with other objects too
+    json::object other;
+    ok &= json::parse(R"({"orders": [{"items": [0, 1, 2, {"price": 4.5}]}]})", other, code) == 1;
+    ok &= price.get(other, d) && d == 4.5;
+    // Members are found after the object grew and was rehashed many times 
+    for(long long n = 0; n < 5000; n++) other.setValue("k" + std::to_string(n), n);
+    ok &= json::path::compile("/k4321").get(other, i) && i == 4321 && price.get(other, d) && d == 4.5;
+
+    json::pathSet paths;
+    std::vector<const json::value*> found;
+    size_t first = paths.add("/orders/0/items/0/price");
+    size_t last = paths.add(price);
+    size_t missing = paths.add("/orders/0/items/4/price");
+    size_t invalid = paths.add("bad");
+    size_t count = paths.add("/count");
+    size_t again = paths.add("/count");
+    paths.resolve(root, found);
+    ok &= found.size() == 6 && found[missing] == nullptr && found[invalid] == nullptr && found[count] == found[again];
+    ok &= found[first] != nullptr && found[first]->getNumber(d) && d == 1.5;
+    ok &= found[last] == price.find(root) && found[count]->getNumber(i) && i == 4;
+    // Paths share the nodes of their common segments
+    ok &= paths.nodes.size() == 11;
+
+    std::cout << name << ": "
+              << (ok ? "\x1B[92mPASS\033[0m" : "\x1B[91mFAIL\033[0m")
+              << "\n";
+    return ok;
+}
+
 int main(void) {
     // Test quite function
     auto runTest = [](const char* json, const char* name, json::parseRetVal retCode, int shouldPass) {
@@ -1158,7 +2556,33 @@ int main(void) {
     runTestObjectCopy("object::copy deep copy") ? success++ : fail++;
 
     outputTest(json_nested_object, "object output test") ? success++ : fail++;
-
+    runTestParallelOutput("parallel output test") ? success++ : fail++;
+    runTestOutputCache("output cache test") ? success++ : fail++;
+    runTestCanonicalOutput("canonical output test") ? success++ : fail++;
+    runTestCanonicalHash("canonical hash test") ? success++ : fail++;
+    runTestDeepDestruction("iterative and deferred destruction test") ? success++ : fail++;
+    runTestParallelCopy("parallel copy test") ? success++ : fail++;
+    runTestSharedCopy("shared copy test") ? success++ : fail++;
+    runTestFrozenDocument("frozen document test") ? success++ : fail++;
+    runTestSnapshot("snapshot test") ? success++ : fail++;
+    runTestCBOR("CBOR test") ? success++ : fail++;
+    runTestMsgPack("MessagePack test") ? success++ : fail++;
+    runTestParseBatch("batch parsing test") ? success++ : fail++;
+    runTestIngestFiles("file ingest test") ? success++ : fail++;
+    runTestParseAsync("async parse test") ? success++ : fail++;
+    runTestReusableParser("reusable parser test") ? success++ : fail++;
+    runTestProjection("projection test") ? success++ : fail++;
+    runTestEarlyStop("early stop test") ? success++ : fail++;
+    runTestLazyNumbers("lazy numbers test") ? success++ : fail++;
+    runTestValidate("validate test") ? success++ : fail++;
+    runTestErrorLocation("error location test") ? success++ : fail++;
+    runTestKeyWhitespace("key whitespace test") ? success++ : fail++;
+    runTestStreamPieces("stream pieces test") ? success++ : fail++;
+    runTestParseParallel("parallel parse test") ? success++ : fail++;
+    runTestSidecar("sidecar index test") ? success++ : fail++;
+    runTestArrayReader("array reader test") ? success++ : fail++;
+    runTestDocumentReader("document reader test") ? success++ : fail++;
+    runTestPaths("compiled path test") ? success++ : fail++;
     // -------------------- RESULTS --------------------
     std::cout << "TEST RESULTS\n";
     std::cout << "\x1B[92mSuccess: " << success<< "\033[0m\n";
@@ -0,0 +1,140 @@
+#include <array>
+#include <cstring>
+#include <unordered_set>
+#include "parkinson.hpp"
+#include "parser.hpp"
+
+// --- UTF-8 ---
+// Sequences are checked with tables indexed by the lead byte: its length and the range of the second byte.
+// Ranges of the second byte exclude overlong forms, surrogates and code points above U+10FFFF
+
+struct utf8Table {
+    std::array<uint8_t, 256> length{};
+    std::array<uint8_t, 256> low{};
+    std::array<uint8_t, 256> high{};
+};
+
+static constexpr utf8Table makeUTF8Table() {
+    utf8Table table;
+    for(int byte = 0; byte < 256; byte++) {
+        table.low[byte] = 0x80;
+        table.high[byte] = 0xbf;
+        if(byte >= 0xc2 && byte <= 0xdf) table.length[byte] = 2;
+        else if(byte >= 0xe0 && byte <= 0xef) table.length[byte] = 3;
+        else if(byte >= 0xf0 && byte <= 0xf4) table.length[byte] = 4;
+    }
+    table.low[0xe0] = 0xa0;
+    table.high[0xed] = 0x9f;
+    table.low[0xf0] = 0x90;
+    table.high[0xf4] = 0x8f;
+    return table;
+}
+
+static constexpr utf8Table UTF8 = makeUTF8Table();
+static constexpr uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+// Offset of the first byte that isn't a part of the well-formed sequence, size if there is none.
+// ASCII, which is most of the text, is skipped 16 bytes at a time
+static size_t findInvalidUTF8(const unsigned char* text, size_t size) {
+    size_t i = 0;
+    while(i < size) {
+        if(size - i >= 16) {
+            uint64_t words[2];
+            std::memcpy(words, text + i, sizeof(words));
+            if(((words[0] | words[1]) & HIGH_BITS) == 0) {
+                i += 16;
+                continue;
+            }
+        }
+        unsigned char lead = text[i];
+        if(lead < 0x80) {
+            i++;
+            continue;
+        }
+        size_t length = UTF8.length[lead];
+        if(length == 0 || size - i < length) return i;
+        if(text[i + 1] < UTF8.low[lead] || text[i + 1] > UTF8.high[lead]) return i;
+        for(size_t k = 2; k < length; k++) {
+            if((text[i + k] & 0xc0) != 0x80) return i;
+        }
+        i += length;
+    }
+    return size;
+}
+
+// --- Grammar ---
+
+// Builder that only checks the keys. Each open object has a set of its keys, 
+// nodes of the sets are kept when the objects end and used for the next keys
+struct validateBuilder {
+    using keySet = std::unordered_set<std::string>;
+    struct buffers {
+        parserScratch scratch;
+        std::vector<keySet> levels;
+        std::vector<keySet::node_type> freeKeys;
+    };
+
+    buffers& keep;
+    size_t depth = 0;
+
+    validateBuilder(buffers& keep) : keep(keep) {
+        // Sets of the document that ended with an error
+        for(auto& level: keep.levels) release(level);
+    }
+
+    void release(keySet& keys) {
+        while(!keys.empty()) keep.freeKeys.push_back(keys.extract(keys.begin()));
+    }
+
+    void beginRoot() { beginObject(); }
+
+    bool key(std::string& key) {
+        keySet& keys = keep.levels[depth - 1];
+        if(keys.contains(key)) return false;
+        if(keep.freeKeys.empty()) {
+            keys.insert(key);
+            return true;
+        }
+        keySet::node_type node = std::move(keep.freeKeys.back());
+        keep.freeKeys.pop_back();
+        node.value().assign(key);
+        keys.insert(std::move(node));
+        return true;
+    }
+
+    void beginObject() {
+        if(keep.levels.size() == depth) keep.levels.emplace_back();
+        depth++;
+    }
+
+    void endObject() {
+        release(keep.levels[depth - 1]);
+        depth--;
+    }
+
+    void beginArray() {}
+    void endArray() {}
+    void value(std::string&&) {}
+    void value(long long) {}
+    void value(double) {}
+    void value(bool) {}
+    void null() {}
+};
+
+int json::validate(std::string_view text, exitCode& code) {
+    thread_local validateBuilder::buffers keep;
+    size_t invalid = findInvalidUTF8(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+    // Grammar is checked up to the bad byte, so the error that comes first in the text is reported
+    bufferSource source{text.data(), text.data() + invalid};
+    validateBuilder builder(keep);
+    textParser<validateBuilder> parser(builder, code, keep.scratch);
+    int result = parser.feed(source.at, source.end);
+    if(result < 0 && invalid == text.size()) result = parser.finish();
+    else if(result < 0) {
+        // Bad byte counts as read
+        constructExitCode(code, PARSE_ERR_INVALID_UTF8, invalid + 1);
+        result = 0;
+    }
+    if(result == 0) locateText(code, text.data(), code.offset);
+    return result;
+}